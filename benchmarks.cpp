@@ -0,0 +1,922 @@
+#include "benchmarks.h"
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+#include "dynamic_resolution.h"
+#include "frame_pacer.h"
+#include "gpu_arena.h"
+#include "job_system.h"
+#include "latency.h"
+#include "mesh_cache.h"
+#include "mesh_export.h"
+#include "picking.h"
+#include "prism.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scene_graph.h"
+#include "simulation.h"
+#include "software_rasterizer.h"
+#include "stats_overlay.h"
+#include "transform_store.h"
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The grid of the scene benchmark, in memory: 100 x 100 prisms per layer, 1.5 apart, with assorted poses
+static void gridScene(int count, Scene &scene)
+{
+    scene.prisms.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        ScenePrism &prism = scene.prisms[i];
+        prism.n = 3 + i % 10;
+        prism.seed = i;
+        prism.centre = glm::vec3((i % 100) * 1.5f, (i / 100 % 100) * 1.5f, (i / 10000) * -1.5f);
+        prism.rotation = glm::vec3((i % 360) * 1.0f, (i % 180) * 2.0f, (i % 90) * 4.0f);
+        prism.scale = 0.5f + (i % 7) * 0.1f;
+        prism.parent = -1;
+    }
+}
+
+// Job system scaling: generate the same large prism with 1 to N workers
+// ----------------------------------------------------------------------
+static int benchmarkJobs()
+{
+    const int n = 250000;
+    const int runs = 5;
+    unsigned int cores = std::thread::hardware_concurrency();
+    PrismMesh mesh;
+    double baseline = 0.0;
+
+    if (cores == 0)
+        cores = 1;
+
+    std::cout << "Job system scaling, generatePrism(n = " << n << "), best of " << runs << std::endl;
+    std::cout << "workers      ms   speedup" << std::endl;
+
+    for (unsigned int workers = 1; workers <= cores; workers++)
+    {
+        JobSystem jobs(workers);
+        double best = 0.0;
+
+        for (int run = 0; run < runs; run++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            generatePrism(n, glm::vec3(0.0f), 1, mesh, jobs);
+            double ms = elapsedMs(start);
+
+            if (run == 0 || ms < best)
+                best = ms;
+        }
+
+        if (workers == 1)
+            baseline = best;
+
+        std::cout << std::setw(7) << workers << std::setw(8) << std::fixed << std::setprecision(2) << best
+                  << std::setw(10) << baseline / best << std::endl;
+    }
+
+    return 0;
+}
+
+// Mesh cache: generating a large prism against loading its cached shape
+// ---------------------------------------------------------------------
+// The same steps as --mesh-cache: a run without a cached shape generates the coloured prism and writes the shape
+// out, and a run with one maps the shape and colours it from the seed. The file is read back from the page cache,
+// so the load figure is the best case; after dropping caches it is bounded by the disk instead.
+static int benchmarkMeshCache()
+{
+    const int n = 1000000;
+    const uint32_t seed = 1;
+    const std::string path = meshCachePath(".", n);
+    JobSystem &jobs = *jobSystem;
+    PrismMesh mesh;
+    PrismShape shape;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    generatePrism(n, glm::vec3(0.0f), seed, mesh, jobs);
+    double generateMs = elapsedMs(start);
+
+    generatePrismShape(n, shape, jobs);
+    start = std::chrono::steady_clock::now();
+    if (!writeShapeFile(path, n, shapeView(shape)))
+    {
+        std::cout << "Failed to write " << path << std::endl;
+        return -1;
+    }
+    double writeMs = elapsedMs(start);
+
+    MappedMesh mapped;
+    start = std::chrono::steady_clock::now();
+    if (!mapped.open(path, n))
+    {
+        std::cout << "Failed to map " << path << std::endl;
+        remove(path.c_str());
+        return -1;
+    }
+    double mapMs = elapsedMs(start);
+
+    // Colouring reads every vertex of the mapping, so this includes faulting the file in
+    start = std::chrono::steady_clock::now();
+    colorPrismShape(n, mapped.shape(), seed, mesh, jobs);
+    double colorMs = elapsedMs(start);
+
+    double megabytes = mapped.size() / (1024.0 * 1024.0);
+    double loadMs = mapMs + colorMs;
+    std::cout << "Mesh cache, n = " << n << ", " << std::fixed << std::setprecision(1) << megabytes << " MB shape" << std::endl;
+    std::cout << std::setprecision(2) << "generate: " << generateMs << " ms" << std::endl;
+    std::cout << "write:    " << writeMs << " ms, " << megabytes / (writeMs / 1000.0) << " MB/s" << std::endl;
+    std::cout << "load:     " << loadMs << " ms (map " << mapMs << " ms, colour " << colorMs << " ms), "
+              << generateMs / loadMs << "x faster than generating" << std::endl;
+
+    remove(path.c_str());
+    return 0;
+}
+
+// Export throughput for both formats
+// ----------------------------------
+static int benchmarkExport()
+{
+    const int n = 1000000;
+    const char *paths[2] = {"prism-bench.obj", "prism-bench.glb"};
+    PrismMesh mesh;
+
+    generatePrism(n, glm::vec3(0.0f), 1, mesh, *jobSystem);
+    std::cout << "Mesh export, n = " << n << std::endl;
+
+    for (int i = 0; i < 2; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool exported = exportMesh(paths[i], n, meshView(mesh));
+        double ms = elapsedMs(start);
+
+        struct stat status;
+        if (!exported || stat(paths[i], &status) != 0)
+        {
+            std::cout << "Failed to export " << paths[i] << std::endl;
+            return -1;
+        }
+
+        double megabytes = status.st_size / (1024.0 * 1024.0);
+        std::cout << paths[i] << ": " << std::fixed << std::setprecision(1) << megabytes << " MB in " << std::setprecision(2)
+                  << ms << " ms, " << megabytes / (ms / 1000.0) << " MB/s" << std::endl;
+        remove(paths[i]);
+    }
+    remove("prism-bench.mtl");
+
+    return 0;
+}
+
+// Scene loading: a million prisms, from text and from the binary form
+// --------------------------------------------------------------------
+static int benchmarkScene()
+{
+    const int count = 1000000;
+    const char *textPath = "prism-bench-scene.txt";
+    const char *binaryPath = "prism-bench-scene.bin";
+    JobSystem &jobs = *jobSystem;
+
+    // A grid of small prisms with assorted poses
+    FILE *file = fopen(textPath, "w");
+    if (!file)
+    {
+        std::cout << "Failed to write " << textPath << std::endl;
+        return -1;
+    }
+
+    fprintf(file, "# n  centre  rotation  scale  seed\n");
+    for (int i = 0; i < count; i++)
+        fprintf(file, "%d %.4f %.4f %.4f %.2f %.2f %.2f %.3f %d\n", 3 + i % 10, (i % 100) * 1.5f, (i / 100 % 100) * 1.5f,
+                (i / 10000) * -1.5f, (i % 360) * 1.0f, (i % 180) * 2.0f, (i % 90) * 4.0f, 0.5f + (i % 7) * 0.1f, i);
+    fclose(file);
+
+    Scene scene;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool loaded = loadScene(textPath, scene, jobs);
+    double textMs = elapsedMs(start);
+
+    if (!loaded || (int)scene.prisms.size() != count || !saveSceneBinary(binaryPath, scene))
+    {
+        std::cout << "Failed to load or convert " << textPath << std::endl;
+        remove(textPath);
+        return -1;
+    }
+
+    Scene binaryScene;
+    start = std::chrono::steady_clock::now();
+    loaded = loadScene(binaryPath, binaryScene, jobs);
+    double binaryMs = elapsedMs(start);
+
+    std::cout << "Scene loading, " << count << " prisms, " << jobs.workerCount() << " workers" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "text:   " << textMs << " ms" << std::endl;
+    std::cout << "binary: " << binaryMs << " ms" << std::endl;
+
+    remove(textPath);
+    remove(binaryPath);
+    return loaded ? 0 : -1;
+}
+
+// Arena sub-allocation: meshes of random sizes coming and going, as when scenes are swapped
+// ------------------------------------------------------------------------------------------
+static int benchmarkArena()
+{
+    const int operations = 1000000;
+    const int live = 2000;
+    const size_t capacity = 40 * 1024 * 1024; // Vertices; the live meshes fill about three quarters of it
+    ArenaAllocator arena(capacity);
+
+    struct Allocation
+    {
+        size_t offset, size;
+    };
+    std::vector<Allocation> allocations;
+    int failed = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < operations; i++)
+    {
+        uint32_t random = hash32(i);
+
+        // Keep about `live` meshes around: once there are that many, free a random one
+        if ((int)allocations.size() >= live)
+        {
+            size_t victim = random % allocations.size();
+            arena.free(allocations[victim].offset, allocations[victim].size);
+            allocations[victim] = allocations.back();
+            allocations.pop_back();
+            continue;
+        }
+
+        // Vertex count of a prism of 3 to 5000 sides
+        Allocation allocation = {0, (size_t)prismVertexCount(3 + (random >> 8) % 4998)};
+        if (arena.allocate(allocation.size, allocation.offset))
+            allocations.push_back(allocation);
+        else
+            failed++;
+    }
+    double ms = elapsedMs(start);
+
+    ArenaStats stats = arena.stats();
+    std::cout << "Arena allocator, " << operations << " allocations and frees, about " << live << " live" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << ms * 1e6 / operations << " ns/operation, " << failed
+              << " allocations did not fit" << std::endl;
+    std::cout << "used " << 100.0 * stats.used / stats.capacity << "%, " << stats.freeBlocks << " free blocks, largest "
+              << stats.largestFree << ", " << 100.0 * arenaFragmentation(stats) << "% fragmented" << std::endl;
+    return 0;
+}
+
+// Picking: rays into a million prisms, through the BVH and by testing every prism
+// ---------------------------------------------------------------------------------
+static int benchmarkPick()
+{
+    const int count = 1000000;
+    const int picks = 100000;
+    const int linearPicks = 20;
+
+    Scene scene;
+    gridScene(count, scene);
+
+    PrismBVH bvh;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bvh.build(scene);
+    double buildMs = elapsedMs(start);
+
+    // Rays from in front of the grid towards random points inside it
+    std::vector<glm::vec3> origins(picks), directions(picks);
+    for (int i = 0; i < picks; i++)
+    {
+        uint32_t a = hash32(3 * i), b = hash32(3 * i + 1), c = hash32(3 * i + 2);
+        origins[i] = glm::vec3(75.0f + (a % 1000) * 0.1f - 50.0f, 75.0f + (b % 1000) * 0.1f - 50.0f, 60.0f);
+        glm::vec3 target((a >> 16) % 1500 * 0.1f, (b >> 16) % 1500 * 0.1f, -((c >> 16) % 1500 * 0.1f));
+        directions[i] = target - origins[i];
+    }
+
+    int hits = 0;
+    PickResult result;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < picks; i++)
+        hits += bvh.pick(origins[i], directions[i], result);
+    double pickMs = elapsedMs(start);
+
+    // Without the BVH: every prism against the ray
+    int mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < linearPicks; i++)
+    {
+        float closest = 1e30f;
+        int closestPrism = -1;
+
+        for (int p = 0; p < count; p++)
+        {
+            glm::mat4 inverse = glm::inverse(scenePrismTransform(scene.prisms[p]));
+            float distance;
+            int face;
+            if (intersectPrism(scene.prisms[p].n, glm::vec3(inverse * glm::vec4(origins[i], 1.0f)),
+                               glm::vec3(inverse * glm::vec4(directions[i], 0.0f)), distance, face) &&
+                distance < closest)
+            {
+                closest = distance;
+                closestPrism = p;
+            }
+        }
+
+        bvh.pick(origins[i], directions[i], result);
+        mismatches += result.prism != closestPrism;
+    }
+    double linearMs = elapsedMs(start);
+
+    std::cout << "Picking, " << count << " prisms" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "BVH build: " << buildMs << " ms, " << bvh.nodeCount() << " nodes, depth "
+              << bvh.depth() << std::endl;
+    std::cout << "BVH:    " << pickMs * 1000.0 / picks << " us/pick, " << 100.0 * hits / picks << "% hits" << std::endl;
+    std::cout << "linear: " << linearMs * 1000.0 / linearPicks << " us/pick, " << mismatches << " of " << linearPicks
+              << " picks disagree with the BVH" << std::endl;
+    return mismatches ? -1 : 0;
+}
+
+// Instance transforms of spinning prisms: glm one prism at a time, against the transform store's SIMD kernel
+// ------------------------------------------------------------------------------------------------------------
+static int benchmarkTransforms()
+{
+    const int count = 100000;
+    const int frames = 100;
+
+    Scene scene;
+    gridScene(count, scene);
+
+    std::vector<glm::mat4> rest(count);
+    for (int i = 0; i < count; i++)
+        rest[i] = scenePrismTransform(scene.prisms[i]);
+
+    // Without parents, graph nodes are in scene order
+    SceneGraph graph;
+    graph.build(scene);
+    TransformStore store;
+    store.build(scene, graph);
+
+    std::vector<AffineTransform> glmTransforms(count), storeTransforms(count);
+
+    // What the renderer used to do for every object: rotate its matrix with glm and copy the rows out
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        float spin = frame * 0.05f;
+        for (int i = 0; i < count; i++)
+            glmTransforms[i] = affineTransform(glm::rotate(rest[i], spin, glm::vec3(1.0f, 0.0f, 0.0f)));
+    }
+    double glmMs = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        store.writeLocals(frame * 0.05f, 0, count, storeTransforms.data());
+    double storeMs = elapsedMs(start);
+
+    // Both hold the last frame now
+    float largestError = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            glm::vec4 delta = glm::abs(glmTransforms[i].rows[row] - storeTransforms[i].rows[row]);
+            largestError = std::max(largestError, std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w)));
+        }
+    }
+
+    std::cout << "Instance transforms, " << count << " spinning prisms, " << frames << " frames, one thread" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "glm:    " << glmMs * 1e6 / ((double)count * frames) << " ns/instance" << std::endl;
+    std::cout << "kernel: " << storeMs * 1e6 / ((double)count * frames) << " ns/instance (" << glmMs / storeMs << "x)" << std::endl;
+    std::cout << std::scientific << "largest difference " << largestError << std::endl;
+    return largestError < 1e-4f ? 0 : -1;
+}
+
+// Scene graph updates: a million prisms in systems of a star, four planets and a moon for each planet
+// ------------------------------------------------------------------------------------------------------
+static int benchmarkSceneGraph()
+{
+    const int systems = 111111;
+    const int updates = 100;
+
+    Scene scene;
+    for (int s = 0; s < systems; s++)
+    {
+        int star = (int)scene.prisms.size();
+        ScenePrism prism = {12, (uint32_t)star, glm::vec3((s % 300) * 8.0f, (s / 300) * 8.0f, 0.0f), glm::vec3(0.0f), 1.0f, -1};
+        scene.prisms.push_back(prism);
+
+        for (int p = 0; p < 4; p++)
+        {
+            int planet = (int)scene.prisms.size();
+            ScenePrism planetPrism = {6, (uint32_t)planet, glm::vec3(1.5f + p, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 90.0f * p), 0.4f, star};
+            ScenePrism moon = {3, (uint32_t)planet + 1, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f), 0.3f, planet};
+            scene.prisms.push_back(planetPrism);
+            scene.prisms.push_back(moon);
+        }
+    }
+
+    SceneGraph graph;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    graph.build(scene);
+    double buildMs = elapsedMs(start);
+
+    std::vector<NodeRange> changed;
+    double ms[3];
+    size_t recomputed[3] = {0, 0, 0};
+
+    // Nothing moved, one star moved (taking its planets and moons along), everything moved
+    for (int mode = 0; mode < 3; mode++)
+    {
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < updates; i++)
+        {
+            if (mode == 1)
+            {
+                uint32_t node = graph.nodeOfPrism(9 * (i % systems));
+                graph.setLocal(node, graph.local(node));
+            }
+            else if (mode == 2)
+                graph.markAllDirty();
+
+            changed.clear();
+            recomputed[mode] += graph.update(changed);
+        }
+        ms[mode] = elapsedMs(start) / updates;
+    }
+
+    // Compare against composing every prism's transform from scratch
+    std::vector<glm::mat4> reference;
+    sceneWorldTransforms(scene, reference);
+    float largestError = 0.0f;
+    for (size_t i = 0; i < scene.prisms.size(); i++)
+    {
+        AffineTransform expected = affineTransform(reference[i]);
+        const AffineTransform &world = graph.world(graph.nodeOfPrism((uint32_t)i));
+        for (int row = 0; row < 3; row++)
+        {
+            glm::vec4 delta = glm::abs(expected.rows[row] - world.rows[row]);
+            largestError = std::max(largestError, std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w)));
+        }
+    }
+
+    const char *modes[3] = {"nothing moved:  ", "one system moved:", "everything moved:"};
+    std::cout << "Scene graph, " << scene.prisms.size() << " prisms, built in " << std::fixed << std::setprecision(2) << buildMs
+              << " ms" << std::endl;
+    for (int mode = 0; mode < 3; mode++)
+        std::cout << modes[mode] << " " << std::setprecision(4) << ms[mode] << " ms/update, " << recomputed[mode] / updates
+                  << " nodes recomputed" << std::endl;
+    std::cout << std::scientific << "largest difference from composing from scratch " << largestError << std::endl;
+    return largestError < 1e-3f ? 0 : -1;
+}
+
+// Software rasterizer throughput, against the GL driver on the same frames
+// ------------------------------------------------------------------------
+// Run with LIBGL_ALWAYS_SOFTWARE=1 to compare against llvmpipe.
+static int benchmarkRaster()
+{
+    const int n = 20000;
+    const int frames = 20;
+    const int width = 800, height = 800;
+    PrismMesh mesh;
+    JobSystem &jobs = *jobSystem;
+
+    generatePrism(n, glm::vec3(0.0f), 1, mesh, jobs);
+
+    int indexCount = (int)mesh.indices.size();
+    double triangles = (double)(indexCount / 3) * frames;
+    glm::mat4 model = glm::rotate(glm::mat4(1.0f), 0.7f, glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::mat4 view = glm::lookAt(glm::vec3(1.0f, 2.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = prismProjection((float)width / (float)height);
+
+    std::cout << "Rasterizer throughput, n = " << n << " (" << indexCount / 3 << " triangles), " << width << "x" << height
+              << ", " << frames << " frames" << std::endl;
+
+    // Software
+    SoftwareRasterizer rasterizer(width, height, jobs);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        rasterizer.clear(glm::vec3(0.2f, 0.3f, 0.3f));
+        rasterizer.draw(mesh.vertices.data(), mesh.indices.data(), indexCount, projection * view * model);
+    }
+    double softwareMs = elapsedMs(start);
+
+    Image softwareImage;
+    rasterizer.readPixels(softwareImage);
+    std::cout << "software (" << jobs.workerCount() << " workers): " << std::fixed << std::setprecision(2) << softwareMs / frames
+              << " ms/frame, " << triangles / (softwareMs / 1000.0) / 1e6 << " Mtri/s" << std::endl;
+
+    // GL
+    GLFWwindow *window = createHiddenContext(width, height);
+    if (!window)
+    {
+        std::cout << "GL: no context available, skipped" << std::endl;
+        return 0;
+    }
+
+    {
+        Scene scene;
+        singlePrismScene(n, 1, glm::vec3(0.0f), scene);
+        PrismRenderer renderer(scene, NULL);
+
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderer.draw(model, view, projection);
+            glFinish();
+        }
+        double glMs = elapsedMs(start);
+
+        Image glImage;
+        readFramebuffer(width, height, glImage);
+
+        // Pixels where any channel differs by more than a couple of steps
+        int mismatched = compareImages(glImage, softwareImage, 2).differingPixels;
+
+        // The renderer picks a level of detail, so it may well draw fewer triangles than the software path
+        std::cout << "GL (" << (const char *)glGetString(GL_RENDERER) << "): " << glMs / frames << " ms/frame" << std::endl;
+        std::cout << "software vs GL: " << 100.0 * mismatched / (width * height) << "% of pixels differ" << std::endl;
+    }
+
+    destroyHiddenContext(window);
+    return 0;
+}
+
+// Statistics overlay cost: CPU time to lay out and submit it and GPU time to draw it, against its 0.1 ms budget
+// ----------------------------------------------------------------------------------------------------------------
+static int benchmarkOverlay()
+{
+    const int frames = 1000;
+    const double budgetMs = 0.1;
+
+    GLFWwindow *window = createHiddenContext(800, 800);
+    if (!window)
+    {
+        std::cout << "GL: no context available, skipped" << std::endl;
+        return 0;
+    }
+
+    double cpuMs = 0.0, gpuMs = 0.0;
+    {
+        StatsOverlay overlay;
+        FrameDrawStats draws = {37, 1000000, 12000000, 220};
+        GLuint timer;
+        glGenQueries(1, &timer);
+
+        for (int frame = 0; frame < frames; frame++)
+        {
+            overlay.beginFrame();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            glBeginQuery(GL_TIME_ELAPSED, timer);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            overlay.draw(draws);
+            cpuMs += elapsedMs(start);
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+            gpuMs += nanoseconds / 1e6;
+        }
+        glDeleteQueries(1, &timer);
+    }
+    destroyHiddenContext(window);
+
+    cpuMs /= frames;
+    gpuMs /= frames;
+    std::cout << "Statistics overlay, " << frames << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(4) << "CPU: " << cpuMs << " ms/frame, GPU: " << gpuMs << " ms/frame (budget "
+              << budgetMs << " ms each)" << std::endl;
+    return cpuMs <= budgetMs && gpuMs <= budgetMs ? 0 : -1;
+}
+
+// Input latency under load: key presses injected from another thread, as the GLFW callback would record them,
+// while the real simulation thread runs and the 100,000-prism grid spins in place, once per pacing mode
+// --------------------------------------------------------------------------------------------------------------
+struct LatencyRun
+{
+    double fps;
+    LatencyStats swap, gpu;
+};
+
+static LatencyRun measureLatency(GLFWwindow *window, PrismRenderer &renderer, const PacingOptions &options, int presses)
+{
+    LatencyTracker latency;
+    FramePacer pacer(options);
+    glm::mat4 projection = prismProjection(1.0f);
+
+    QUIT_REQUESTED = false;
+    std::thread simulation(simulationLoop);
+
+    // W is tapped at uneven intervals so presses land all over the tick
+    std::thread keys([&]() {
+        for (int i = 0; i < presses; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(40 + hash32(i) % 80));
+            recordKeyEvent(GLFW_KEY_W, GLFW_PRESS);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            recordKeyEvent(GLFW_KEY_W, GLFW_RELEASE);
+        }
+
+        QUIT_REQUESTED = true;
+        inputEvent.notify();
+        frameEvent.notify();
+    });
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (!QUIT_REQUESTED.load())
+    {
+        if (!frameSnapshots.update())
+        {
+            pacer.markIdle();
+            frameEvent.wait();
+            continue;
+        }
+
+        pacer.beginFrame();
+        frameSnapshots.update();
+        const FrameSnapshot &snapshot = frameSnapshots.readBuffer();
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderer.setSpin(snapshot.spin);
+        renderer.draw(snapshot.model, snapshot.view, projection);
+        glfwSwapBuffers(window);
+        pacer.endFrame();
+        latency.frameSwapped(snapshot.inputTime);
+        latency.poll();
+    }
+    double seconds = elapsedMs(start) / 1000.0;
+
+    keys.join();
+    simulation.join();
+    latency.poll(true);
+
+    LatencyRun run = {pacer.stats().frames / seconds, latency.swapStats(), latency.gpuStats()};
+    return run;
+}
+
+static int benchmarkLatency()
+{
+    const int count = 100000;
+    const int presses = 40;
+    const int modeCount = 5;
+    const PacingOptions modes[modeCount] = {{0, 0.0, false}, {2, 0.0, false}, {1, 0.0, false}, {2, 60.0, false}, {1, 60.0, true}};
+    const char *modeNames[modeCount] = {"unthrottled", "2 frames in flight", "1 frame in flight", "60 fps cap",
+                                        "low latency, 60 fps cap"};
+
+    GLFWwindow *window = createHiddenContext(800, 800);
+    if (!window)
+    {
+        std::cout << "GL: no context available, skipped" << std::endl;
+        return 0;
+    }
+
+    // Without vsync, nothing but the pacer keeps the CPU from queueing up frames
+    glfwSwapInterval(0);
+
+    Scene scene;
+    gridScene(count, scene);
+    LatencyRun runs[modeCount];
+    {
+        PrismRenderer renderer(scene, NULL);
+
+        // R starts the spin, which keeps every frame busy
+        PRISMS_SPIN_IN_PLACE = true;
+        recordKeyEvent(GLFW_KEY_R, GLFW_PRESS);
+        recordKeyEvent(GLFW_KEY_R, GLFW_RELEASE);
+
+        for (int mode = 0; mode < modeCount; mode++)
+            runs[mode] = measureLatency(window, renderer, modes[mode], presses);
+    }
+    destroyHiddenContext(window);
+
+    std::cout << "Input latency, " << presses << " presses of W per mode, " << count << " prisms spinning" << std::endl;
+    int result = 0;
+    for (int mode = 0; mode < modeCount; mode++)
+    {
+        std::cout << modeNames[mode] << ": " << std::fixed << std::setprecision(1) << runs[mode].fps << " fps" << std::endl;
+        printLatencyStats("  key to swap", runs[mode].swap);
+        printLatencyStats("  key to frame done on the GPU", runs[mode].gpu);
+        if (runs[mode].gpu.count == 0)
+            result = -1;
+    }
+    return result;
+}
+
+// Dynamic resolution: time the grid at full resolution, then give it half that as a budget and let the scale settle
+// --------------------------------------------------------------------------------------------------------------------
+static int benchmarkResolution()
+{
+    const int count = 100000;
+    const int frames = 300;
+    const int width = 800, height = 800;
+
+    GLFWwindow *window = createHiddenContext(width, height);
+    if (!window)
+    {
+        std::cout << "GL: no context available, skipped" << std::endl;
+        return 0;
+    }
+
+    Scene scene;
+    gridScene(count, scene);
+    glm::mat4 view = glm::lookAt(glm::vec3(75.0f, 75.0f, 40.0f), glm::vec3(75.0f, 75.0f, -75.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = prismProjection((float)width / (float)height);
+    double fullMs = 0.0, scaledMs = 0.0;
+    float scale = 1.0f;
+    unsigned long long changes = 0;
+
+    {
+        PrismRenderer renderer(scene, NULL);
+        GLuint timer;
+        glGenQueries(1, &timer);
+
+        // Full resolution, drawn straight to the window
+        for (int frame = 0; frame < frames / 10; frame++)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, timer);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderer.draw(glm::mat4(1.0f), view, projection);
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+            fullMs += nanoseconds / 1e6;
+        }
+        fullMs /= frames / 10;
+
+        // Half of that as the budget; the last tenth of the frames is timed, once the scale has settled
+        RenderTargetPool targets;
+        DynamicResolution resolution(fullMs / 2.0, targets);
+        for (int frame = 0; frame < frames; frame++)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, timer);
+            resolution.beginFrame();
+            renderer.setViewport(resolution.renderWidth(), resolution.renderHeight());
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderer.draw(glm::mat4(1.0f), view, projection);
+            resolution.endFrame();
+            glEndQuery(GL_TIME_ELAPSED);
+            glfwSwapBuffers(window);
+
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+            if (frame >= frames - frames / 10)
+                scaledMs += nanoseconds / 1e6;
+        }
+        scaledMs /= frames / 10;
+        scale = resolution.scale();
+        changes = resolution.stats().changes;
+        glDeleteQueries(1, &timer);
+    }
+    destroyHiddenContext(window);
+
+    std::cout << "Dynamic resolution, " << count << " prisms, " << width << "x" << height << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "full resolution: " << fullMs << " ms/frame on the GPU" << std::endl;
+    std::cout << "budget " << fullMs / 2.0 << " ms: " << scaledMs << " ms/frame at scale " << scale << " after " << changes
+              << " changes" << std::endl;
+    return 0;
+}
+
+// Split screen: the 100,000-prism grid from four cameras, as four separate frames' worth of draws and as one
+// multi-view draw, against one camera on its own
+// --------------------------------------------------------------------------------------------------------------
+static int benchmarkViews()
+{
+    const int count = 100000;
+    const int frames = 100;
+    const int width = 800, height = 800;
+    const int viewCount = 4;
+
+    GLFWwindow *window = createHiddenContext(width, height);
+    if (!window)
+    {
+        std::cout << "GL: no context available, skipped" << std::endl;
+        return 0;
+    }
+
+    Scene scene;
+    gridScene(count, scene);
+    glm::mat4 projection = prismProjection((float)width / (float)height);
+    const glm::vec3 eyes[viewCount] = {glm::vec3(75.0f, 75.0f, 40.0f), glm::vec3(-20.0f, 75.0f, 20.0f),
+                                       glm::vec3(170.0f, 160.0f, 20.0f), glm::vec3(75.0f, -30.0f, 10.0f)};
+    RenderView views[viewCount];
+    for (int v = 0; v < viewCount; v++)
+    {
+        views[v].view = glm::lookAt(eyes[v], glm::vec3(75.0f, 75.0f, -7.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        views[v].projection = projection;
+        views[v].x = v % 2 * width / 2;
+        views[v].y = v / 2 * height / 2;
+        views[v].width = width / 2;
+        views[v].height = height / 2;
+    }
+
+    // One camera, four cameras drawn one after another, four cameras in one multi-view draw
+    const char *modes[3] = {"1 view", "4 views, drawn separately", "4 views, one multi-view draw"};
+    double cpuMs[3] = {0.0, 0.0, 0.0}, gpuMs[3] = {0.0, 0.0, 0.0};
+    {
+        PrismRenderer renderer(scene, NULL);
+        GLuint timer;
+        glGenQueries(1, &timer);
+
+        for (int mode = 0; mode < 3; mode++)
+        {
+            for (int frame = 0; frame <= frames; frame++)
+            {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glBeginQuery(GL_TIME_ELAPSED, timer);
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                if (mode == 0)
+                {
+                    renderer.setViewport(width, height);
+                    renderer.draw(glm::mat4(1.0f), views[0].view, projection);
+                }
+                else if (mode == 1)
+                {
+                    for (int v = 0; v < viewCount; v++)
+                    {
+                        renderer.setViewport(views[v].width, views[v].height);
+                        glViewport(views[v].x, views[v].y, views[v].width, views[v].height);
+                        renderer.draw(glm::mat4(1.0f), views[v].view, projection);
+                    }
+                }
+                else
+                {
+                    renderer.setViewport(width, height);
+                    renderer.drawViews(glm::mat4(1.0f), views, viewCount);
+                }
+                double ms = elapsedMs(start);
+                glEndQuery(GL_TIME_ELAPSED);
+                glfwSwapBuffers(window);
+
+                // The first frame of every mode is a warm-up
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+                if (frame > 0)
+                {
+                    cpuMs[mode] += ms;
+                    gpuMs[mode] += nanoseconds / 1e6;
+                }
+            }
+            cpuMs[mode] /= frames;
+            gpuMs[mode] /= frames;
+        }
+        glDeleteQueries(1, &timer);
+    }
+    destroyHiddenContext(window);
+
+    std::cout << "Multi-view, " << count << " prisms, " << width << "x" << height << std::endl;
+    for (int mode = 0; mode < 3; mode++)
+        std::cout << std::fixed << std::setprecision(2) << modes[mode] << ": CPU " << cpuMs[mode] << " ms/frame, GPU "
+                  << gpuMs[mode] << " ms/frame (" << (cpuMs[0] > 0.0 ? cpuMs[mode] / cpuMs[0] : 0.0) << "x the CPU of one view)"
+                  << std::endl;
+    return 0;
+}
+
+int runBenchmark(const char *name)
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    JobSystem jobs(cores > 1 ? cores - 1 : 1);
+    jobSystem = &jobs;
+
+    if (strcmp(name, "jobs") == 0)
+        return benchmarkJobs();
+    if (strcmp(name, "raster") == 0)
+        return benchmarkRaster();
+    if (strcmp(name, "meshcache") == 0)
+        return benchmarkMeshCache();
+    if (strcmp(name, "export") == 0)
+        return benchmarkExport();
+    if (strcmp(name, "scene") == 0)
+        return benchmarkScene();
+    if (strcmp(name, "arena") == 0)
+        return benchmarkArena();
+    if (strcmp(name, "pick") == 0)
+        return benchmarkPick();
+    if (strcmp(name, "transforms") == 0)
+        return benchmarkTransforms();
+    if (strcmp(name, "scenegraph") == 0)
+        return benchmarkSceneGraph();
+    if (strcmp(name, "overlay") == 0)
+        return benchmarkOverlay();
+    if (strcmp(name, "latency") == 0)
+        return benchmarkLatency();
+    if (strcmp(name, "resolution") == 0)
+        return benchmarkResolution();
+    if (strcmp(name, "views") == 0)
+        return benchmarkViews();
+
+    std::cout << "Unknown benchmark '" << name << "'. Available: jobs, raster, meshcache, export, scene, arena, pick, transforms, scenegraph, overlay, latency, resolution, views" << std::endl;
+    return -1;
+}
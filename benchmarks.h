@@ -0,0 +1,7 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+// Run the named benchmark and print its results to stdout; returns the process exit code
+int runBenchmark(const char *name);
+
+#endif
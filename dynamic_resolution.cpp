@@ -0,0 +1,127 @@
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <math.h>
+
+// The scale stays within these, and moves by at most RESOLUTION_MAX_STEP at a time
+const float RESOLUTION_MIN_SCALE = 0.5f;
+const float RESOLUTION_MAX_SCALE = 1.0f;
+const float RESOLUTION_MAX_STEP = 0.1f;
+
+// Going over budget aims for this share of it, to leave room for noise; the scale only goes up again below
+// RESOLUTION_GROW_BELOW of the budget, and by less than it would come down
+const double RESOLUTION_TARGET_LOAD = 0.85;
+const double RESOLUTION_GROW_BELOW = 0.7;
+const float RESOLUTION_GROW_STEP = 0.05f;
+
+// Changes smaller than this are not worth a different resolution
+const float RESOLUTION_MIN_CHANGE = 0.01f;
+
+DynamicResolution::DynamicResolution(double budget, RenderTargetPool &pool) : budgetMs(budget), targets(pool)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    target = NULL;
+    windowWidth = windowHeight = 0;
+    renderScale = RESOLUTION_MAX_SCALE;
+    framesToHold = 0;
+    setWindowSize(viewport[2], viewport[3]);
+    fitTarget();
+
+    timers = new GpuTimerRing(TIMER_FRAMES, 2);
+
+    counters = DynamicResolutionStats();
+    counters.minScale = renderScale;
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    delete timers;
+    targets.release(target);
+}
+
+void DynamicResolution::setWindowSize(int newWidth, int newHeight)
+{
+    windowWidth = std::max(newWidth, 1);
+    windowHeight = std::max(newHeight, 1);
+    if (target)
+        updateSize();
+}
+
+bool DynamicResolution::targetFits() const
+{
+    return target && target->width == renderTargetBucket(windowWidth) && target->height == renderTargetBucket(windowHeight);
+}
+
+void DynamicResolution::fitTarget()
+{
+    if (targetFits())
+        return;
+
+    targets.release(target);
+    target = targets.acquire(windowWidth, windowHeight);
+    updateSize();
+}
+
+// Until the target is fitted to a larger window, the scene is drawn at what the target holds
+void DynamicResolution::updateSize()
+{
+    width = std::min(std::max(1, (int)(windowWidth * renderScale + 0.5f)), target->width);
+    height = std::min(std::max(1, (int)(windowHeight * renderScale + 0.5f)), target->height);
+}
+
+void DynamicResolution::adjust(double gpuMs)
+{
+    if (framesToHold > 0)
+    {
+        framesToHold--;
+        return;
+    }
+
+    double load = gpuMs / budgetMs;
+    float scale = renderScale;
+    if (load > 1.0)
+        scale = renderScale * (float)sqrt(RESOLUTION_TARGET_LOAD / load);
+    else if (load < RESOLUTION_GROW_BELOW)
+        scale = renderScale + RESOLUTION_GROW_STEP;
+
+    scale = std::min(std::max(scale, renderScale - RESOLUTION_MAX_STEP), renderScale + RESOLUTION_MAX_STEP);
+    scale = std::min(std::max(scale, RESOLUTION_MIN_SCALE), RESOLUTION_MAX_SCALE);
+    if (fabsf(scale - renderScale) < RESOLUTION_MIN_CHANGE)
+        return;
+
+    // Frames already in flight were drawn at the old scale
+    renderScale = scale;
+    framesToHold = TIMER_FRAMES;
+    counters.changes++;
+    counters.minScale = std::min(counters.minScale, renderScale);
+    updateSize();
+}
+
+void DynamicResolution::beginFrame()
+{
+    // Adjust to every frame whose timestamps have landed, oldest first
+    GLuint64 stamps[2];
+    while (timers->read(stamps))
+        adjust((stamps[1] - stamps[0]) / 1e6);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glViewport(0, 0, width, height);
+
+    timers->stamp(0);
+
+    counters.frames++;
+    counters.scaleSum += renderScale;
+}
+
+void DynamicResolution::endFrame()
+{
+    timers->stamp(1);
+    timers->endFrame();
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
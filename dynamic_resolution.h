@@ -0,0 +1,85 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include "gpu_timers.h"
+#include "render_targets.h"
+
+struct DynamicResolutionStats
+{
+    unsigned long long frames;
+    unsigned long long changes; // Times the render scale moved
+    double scaleSum;            // Over all frames, for the average
+    float minScale;
+};
+
+// Dynamic render resolution
+// -------------------------
+// The scene is drawn into an offscreen framebuffer at a fraction of the window's resolution and stretched over the
+// window with one linear blit. The fraction follows the GPU time of the scene, measured with timestamp queries a
+// few frames late: when a frame goes over the budget, the scale drops in proportion to the square root of how far
+// over it is, since fill cost goes with the pixel count, and it creeps back up once frames are well under budget.
+// After every change the scale holds until frames drawn at the new resolution have been timed. The render target
+// comes from a pool at the window's full size and only a corner of it is used, so changing the scale allocates
+// nothing; when the window is resized, the scene is drawn at what still fits the target until fitTarget() swaps it.
+// Must be created and used on the thread that owns the context.
+class DynamicResolution
+{
+public:
+    static const int TIMER_FRAMES = 4;
+
+    DynamicResolution(double budgetMs, RenderTargetPool &pool);
+    ~DynamicResolution();
+
+    // Takes effect at once, within the current target
+    void setWindowSize(int width, int height);
+
+    // Whether the target is the size the window calls for, and swapping it for one that is
+    bool targetFits() const;
+    void fitTarget();
+
+    // Bind the offscreen framebuffer and start timing; the scene goes into its bottom-left renderWidth() x
+    // renderHeight() pixels
+    void beginFrame();
+
+    // Stop timing and blit the scene to the window's framebuffer, which is left bound with a full-window viewport
+    void endFrame();
+
+    int renderWidth() const
+    {
+        return width;
+    }
+
+    int renderHeight() const
+    {
+        return height;
+    }
+
+    float scale() const
+    {
+        return renderScale;
+    }
+
+    const DynamicResolutionStats &stats() const
+    {
+        return counters;
+    }
+
+private:
+    void adjust(double gpuMs);
+    void updateSize();
+
+    double budgetMs;
+    RenderTargetPool &targets;
+    RenderTarget *target;
+    int windowWidth, windowHeight;
+    int width, height;
+    float renderScale;
+    int framesToHold; // Timed frames to ignore before adjusting again
+
+    // Two timestamps per frame: before the scene and after it, before the blit
+    GpuTimerRing *timers;
+    DynamicResolutionStats counters;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "frame_pacer.h"
+#include <thread>
+#include "simulation.h"
+#include "threading.h"
+
+// Sleeps are cut this short of the slot and the rest is spun, as waking up can take this long
+const std::chrono::microseconds PACING_SPIN_MARGIN(1500);
+
+// Weight of the newest interval in the running average of frame intervals
+const double PACING_INTERVAL_SMOOTHING = 0.1;
+
+FramePacer::FramePacer(const PacingOptions &pacingOptions) : options(pacingOptions)
+{
+    if (options.lowLatency)
+        options.maxFramesInFlight = 1;
+
+    period = std::chrono::steady_clock::duration::zero();
+    if (options.fpsCap > 0.0)
+        period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.fpsCap));
+
+    nextSlot = std::chrono::steady_clock::now();
+    haveLastStart = false;
+    averageIntervalMs = 0.0;
+    counters = PacingStats();
+}
+
+FramePacer::~FramePacer()
+{
+    for (size_t i = 0; i < fences.size(); i++)
+        glDeleteSync(fences[i]);
+    nextFrameStart = 0;
+}
+
+void FramePacer::beginFrame()
+{
+    // Wait for the GPU: with maxFramesInFlight frames queued, this one would be one too many
+    if (options.maxFramesInFlight > 0 && (int)fences.size() >= options.maxFramesInFlight)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        counters.fenceWaits++;
+        while ((int)fences.size() >= options.maxFramesInFlight)
+        {
+            glClientWaitSync(fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+            glDeleteSync(fences.front());
+            fences.pop_front();
+        }
+        counters.fenceWaitMs += millisecondsBetween(start, std::chrono::steady_clock::now());
+    }
+
+    // Wait for the frame's slot: sleep most of the way, then spin
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (period != std::chrono::steady_clock::duration::zero())
+    {
+        if (now < nextSlot)
+        {
+            std::chrono::steady_clock::time_point sleepStart = now;
+            if (nextSlot - now > PACING_SPIN_MARGIN)
+                std::this_thread::sleep_until(nextSlot - PACING_SPIN_MARGIN);
+
+            std::chrono::steady_clock::time_point spinStart = std::chrono::steady_clock::now();
+            while ((now = std::chrono::steady_clock::now()) < nextSlot)
+                std::this_thread::yield();
+
+            counters.sleepMs += millisecondsBetween(sleepStart, now);
+            counters.spinMs += millisecondsBetween(spinStart, now);
+        }
+
+        // A late frame moves the schedule along rather than letting the next frames catch up in a burst: the next
+        // slot is a whole period after this frame's start if this one started past its own
+        nextSlot = nextSlot + period > now ? nextSlot + period : now + period;
+    }
+
+    if (haveLastStart)
+    {
+        double intervalMs = millisecondsBetween(lastStart, now);
+        averageIntervalMs = averageIntervalMs > 0.0 ? averageIntervalMs + PACING_INTERVAL_SMOOTHING * (intervalMs - averageIntervalMs)
+                                                    : intervalMs;
+    }
+    lastStart = now;
+    haveLastStart = true;
+
+    // The next frame starts at its slot under a cap, otherwise about an average interval from now
+    if (options.lowLatency)
+    {
+        std::chrono::steady_clock::time_point next = period != std::chrono::steady_clock::duration::zero()
+                                                         ? nextSlot
+                                                         : now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                                     std::chrono::duration<double, std::milli>(averageIntervalMs));
+        nextFrameStart = std::chrono::duration_cast<std::chrono::nanoseconds>(next.time_since_epoch()).count();
+    }
+    counters.frames++;
+}
+
+void FramePacer::endFrame()
+{
+    if (options.maxFramesInFlight > 0)
+        fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+void FramePacer::markIdle()
+{
+    haveLastStart = false;
+    nextFrameStart = 0;
+}
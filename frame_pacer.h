@@ -0,0 +1,64 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <deque>
+
+// How the render thread paces its frames
+struct PacingOptions
+{
+    int maxFramesInFlight; // Frames submitted but not finished by the GPU before the next one waits; 0 for no limit
+    double fpsCap;         // Frames per second at most; 0 for no cap
+    bool lowLatency;       // One frame in flight, and the simulation samples input just before each frame starts
+};
+
+struct PacingStats
+{
+    unsigned long long frames;
+    unsigned long long fenceWaits; // Frames that had to wait for an earlier frame to finish on the GPU
+    double fenceWaitMs;
+    double sleepMs; // Held back by the frame rate cap, asleep and then spinning
+    double spinMs;
+};
+
+// Frame pacing
+// ------------
+// Keeps the CPU from running ahead of the GPU and the display. Every swapped frame is followed by a fence; before a
+// frame starts, the pacer waits on the oldest fence until no more than maxFramesInFlight - 1 frames are still
+// queued, so the driver cannot buffer up frames that all add latency. With a frame rate cap, frames start on a
+// fixed schedule: the pacer sleeps until shortly before a frame's slot and spins for the rest, since sleeps
+// overshoot by up to a scheduler quantum. In low-latency mode, it tells the simulation when the next frame is
+// expected to start, so that the simulation can sample input right before it instead of up to a tick earlier.
+// Must be used on the thread that owns the context.
+class FramePacer
+{
+public:
+    explicit FramePacer(const PacingOptions &options);
+    ~FramePacer();
+
+    // Wait until the next frame may start: for the GPU, then for the frame's slot under the cap
+    void beginFrame();
+
+    // Right after the frame's swap
+    void endFrame();
+
+    // The pacer is idle until the next beginFrame(), as the render thread is waiting for something to draw
+    void markIdle();
+
+    const PacingStats &stats() const
+    {
+        return counters;
+    }
+
+private:
+    PacingOptions options;
+    std::chrono::steady_clock::duration period; // Zero without a cap
+    std::chrono::steady_clock::time_point nextSlot, lastStart;
+    bool haveLastStart;
+    double averageIntervalMs; // Between frame starts, for predicting the next one without a cap
+    std::deque<GLsync> fences;
+    PacingStats counters;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "golden.h"
+#include <glad/glad.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "image.h"
+#include "job_system.h"
+#include "prism.h"
+#include "renderer.h"
+#include "scene.h"
+#include "simulation.h"
+#include "software_rasterizer.h"
+
+struct GoldenCase
+{
+    const char *name;
+    int n;
+    unsigned int seed;
+    CameraScript camera;
+    int frame;
+};
+
+static const GoldenCase GOLDEN_CASES[] = {
+    {"start-n6", 6, 1, CAMERA_START, 0},
+    {"preset1-n6", 6, 1, CAMERA_PRESET_1, 0},
+    {"preset2-n6", 6, 1, CAMERA_PRESET_2, 0},
+    {"preset1-n3", 3, 2, CAMERA_PRESET_1, 0},
+    {"preset2-n1000", 1000, 3, CAMERA_PRESET_2, 0},
+    {"turntable-n8-f90", 8, 4, CAMERA_TURNTABLE, 90},
+    {"turntable-n8-f200", 8, 4, CAMERA_TURNTABLE, 200},
+    {"rotated-n5-f30", 5, 5, CAMERA_ROTATED, 30},
+    {"rotated-n12-f100", 12, 6, CAMERA_ROTATED, 100},
+    {"preset1-n20000", 20000, 7, CAMERA_PRESET_1, 0},
+};
+
+const int GOLDEN_WIDTH = 800;
+const int GOLDEN_HEIGHT = 800;
+const int GOLDEN_RUNS = 5; // Timings are the best of this many runs, after one warm-up
+
+// A pixel counts as changed when a channel moves by more than GOLDEN_TOLERANCE; a case fails once more than
+// GOLDEN_MAX_CHANGED of its pixels have changed, which leaves room for rounding differences between drivers
+const int GOLDEN_TOLERANCE = 2;
+const double GOLDEN_MAX_CHANGED = 0.001;
+
+// Recorded budgets are the measured time times GOLDEN_BUDGET_HEADROOM, but never under GOLDEN_BUDGET_FLOOR_MS
+const double GOLDEN_BUDGET_HEADROOM = 2.0;
+const double GOLDEN_BUDGET_FLOOR_MS = 1.0;
+
+struct GoldenBudget
+{
+    double generationMs;
+    double frameMs;
+};
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string goldenPath(const char *directory, const char *backend, const char *name)
+{
+    return std::string(directory) + "/" + backend + "-" + name + ".ppm";
+}
+
+// budgets-<backend>.txt: one "<case> <generation ms> <frame ms>" line per case, '#' starts a comment
+static bool readBudgets(const std::string &path, std::map<std::string, GoldenBudget> &budgets)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file)
+        return false;
+
+    char line[256], name[128];
+    GoldenBudget budget;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%127s %lf %lf", name, &budget.generationMs, &budget.frameMs) == 3)
+            budgets[name] = budget;
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool writeBudgets(const std::string &path, const std::map<std::string, GoldenBudget> &budgets)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "# case generation_ms frame_ms\n");
+    for (std::map<std::string, GoldenBudget>::const_iterator it = budgets.begin(); it != budgets.end(); ++it)
+        fprintf(file, "%s %.3f %.3f\n", it->first.c_str(), it->second.generationMs, it->second.frameMs);
+
+    return fclose(file) == 0;
+}
+
+static double budgetFor(double measuredMs)
+{
+    double budget = measuredMs * GOLDEN_BUDGET_HEADROOM;
+    return budget > GOLDEN_BUDGET_FLOOR_MS ? budget : GOLDEN_BUDGET_FLOOR_MS;
+}
+
+// Generate the case's prism; returns the best time
+static double generateCase(const GoldenCase &test, PrismMesh &mesh)
+{
+    double best = 0.0;
+
+    for (int run = 0; run <= GOLDEN_RUNS; run++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        generatePrism(test.n, c, test.seed, mesh, *jobSystem);
+        double ms = elapsedMs(start);
+
+        if (run == 1 || (run > 1 && ms < best))
+            best = ms;
+    }
+
+    return best;
+}
+
+// Draw the case's frame with the chosen backend and read it back; returns the best frame time
+static double renderCase(const GoldenCase &test, const PrismMesh &mesh, const FrameSnapshot &snapshot, bool useGL, Image &image)
+{
+    glm::mat4 projection = prismProjection((float)GOLDEN_WIDTH / (float)GOLDEN_HEIGHT);
+    double best = 0.0;
+
+    if (useGL)
+    {
+        // The GL path draws the shared shape with colours from the seed, not the baked mesh
+        Scene scene;
+        singlePrismScene(test.n, test.seed, c, scene);
+        PrismRenderer renderer(scene, NULL);
+
+        for (int run = 0; run <= GOLDEN_RUNS; run++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderer.draw(snapshot.model, snapshot.view, projection);
+            glFinish();
+            double ms = elapsedMs(start);
+
+            if (run == 1 || (run > 1 && ms < best))
+                best = ms;
+        }
+
+        readFramebuffer(GOLDEN_WIDTH, GOLDEN_HEIGHT, image);
+        return best;
+    }
+
+    SoftwareRasterizer rasterizer(GOLDEN_WIDTH, GOLDEN_HEIGHT, *jobSystem);
+    for (int run = 0; run <= GOLDEN_RUNS; run++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        rasterizer.clear(glm::vec3(0.2f, 0.3f, 0.3f));
+        rasterizer.draw(mesh.vertices.data(), mesh.indices.data(), (int)mesh.indices.size(),
+                        projection * snapshot.view * snapshot.model);
+        double ms = elapsedMs(start);
+
+        if (run == 1 || (run > 1 && ms < best))
+            best = ms;
+    }
+
+    rasterizer.readPixels(image);
+    return best;
+}
+
+int runGoldenSuite(const char *mode, const char *directory, const char *backend)
+{
+    bool recordImages = strcmp(mode, "record") == 0;
+    bool record = recordImages || strcmp(mode, "budgets") == 0;
+    bool useGL = strcmp(backend, "gl") == 0;
+
+    if ((!record && strcmp(mode, "check") != 0) || (!useGL && strcmp(backend, "software") != 0))
+    {
+        std::cout << "Usage: --golden record|budgets|check <directory> [software|gl]" << std::endl;
+        return -1;
+    }
+
+    unsigned int cores = std::thread::hardware_concurrency();
+    JobSystem jobs(cores > 1 ? cores - 1 : 1);
+    jobSystem = &jobs;
+
+    std::string budgetPath = std::string(directory) + "/budgets-" + backend + ".txt";
+    std::map<std::string, GoldenBudget> budgets;
+
+    // Timings depend on the machine, so budgets are recorded on it; without them, only the images are checked
+    bool checkBudgets = !record && readBudgets(budgetPath, budgets);
+    if (!record && !checkBudgets)
+        std::cout << "No budgets at " << budgetPath << "; checking images only (run with 'budgets' to record them)" << std::endl;
+
+    GLFWwindow *window = NULL;
+    if (useGL)
+    {
+        window = createHiddenContext(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+        if (!window)
+        {
+            std::cout << "GL: no context available" << std::endl;
+            return -1;
+        }
+    }
+
+    int failures = 0;
+    PrismMesh mesh;
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (size_t i = 0; i < sizeof(GOLDEN_CASES) / sizeof(GOLDEN_CASES[0]); i++)
+    {
+        const GoldenCase &test = GOLDEN_CASES[i];
+        std::string path = goldenPath(directory, backend, test.name);
+
+        FrameSnapshot snapshot;
+        double generationMs = generateCase(test, mesh);
+        scriptedSnapshot(test.camera, test.frame, snapshot);
+
+        Image image;
+        double frameMs = renderCase(test, mesh, snapshot, useGL, image);
+
+        if (record)
+        {
+            bool written = !recordImages || writePPM(path.c_str(), image);
+            GoldenBudget budget = {budgetFor(generationMs), budgetFor(frameMs)};
+            budgets[test.name] = budget;
+
+            std::cout << (written ? "RECORDED " : "FAILED   ") << test.name << ": generation " << generationMs << " ms, frame "
+                      << frameMs << " ms" << std::endl;
+            if (!written)
+                failures++;
+            continue;
+        }
+
+        // Check: image first, then both budgets
+        std::string problem;
+        Image golden;
+        std::map<std::string, GoldenBudget>::const_iterator budget = budgets.find(test.name);
+
+        if (!readPPM(path.c_str(), golden))
+            problem = "no golden image at " + path;
+        else if (golden.width != image.width || golden.height != image.height)
+            problem = "golden image has a different size";
+        else if (checkBudgets && budget == budgets.end())
+            problem = "no budget recorded";
+
+        ImageDifference difference = {0, 0};
+        if (problem.empty())
+        {
+            difference = compareImages(image, golden, GOLDEN_TOLERANCE);
+            if (difference.differingPixels > GOLDEN_MAX_CHANGED * image.width * image.height)
+                problem = "image changed";
+            else if (checkBudgets && generationMs > budget->second.generationMs)
+                problem = "generation over budget";
+            else if (checkBudgets && frameMs > budget->second.frameMs)
+                problem = "frame over budget";
+        }
+
+        std::cout << (problem.empty() ? "PASS     " : "FAIL     ") << test.name;
+        if (!checkBudgets)
+            std::cout << ": " << difference.differingPixels << " pixels changed (max " << difference.maxDifference << "), generation "
+                      << generationMs << " ms, frame " << frameMs << " ms";
+        else if (budget != budgets.end())
+            std::cout << ": " << difference.differingPixels << " pixels changed (max " << difference.maxDifference << "), generation "
+                      << generationMs << "/" << budget->second.generationMs << " ms, frame " << frameMs << "/"
+                      << budget->second.frameMs << " ms";
+        if (!problem.empty())
+        {
+            std::cout << " - " << problem;
+            failures++;
+        }
+        std::cout << std::endl;
+    }
+
+    if (record && !writeBudgets(budgetPath, budgets))
+    {
+        std::cout << "Failed to write " << budgetPath << std::endl;
+        failures++;
+    }
+
+    if (window)
+        destroyHiddenContext(window);
+
+    std::cout << failures << " of " << sizeof(GOLDEN_CASES) / sizeof(GOLDEN_CASES[0]) << " cases failed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+// Golden-image regression run
+// ---------------------------
+// Renders a fixed set of prisms (n, colour seed and a scripted camera) headlessly and either records the images and
+// timing budgets into directory ("record"), records only the budgets ("budgets"), or compares against what was
+// recorded there ("check"); the images are checked even when no budgets were recorded. The backend is "software"
+// (default) or "gl". Prints one line per case; returns 0 when every case passed.
+int runGoldenSuite(const char *mode, const char *directory, const char *backend);
+
+#endif
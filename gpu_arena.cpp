@@ -0,0 +1,113 @@
+#include "gpu_arena.h"
+
+ArenaAllocator::ArenaAllocator(size_t capacity) : capacity(capacity), used(0), nonEmptyClasses(0)
+{
+    if (capacity > 0)
+        insertFree(0, capacity);
+}
+
+int ArenaAllocator::sizeClass(size_t size)
+{
+    int k = 0;
+    while (size >>= 1)
+        k++;
+    return k;
+}
+
+bool ArenaAllocator::allocate(size_t size, size_t &offset)
+{
+    if (size == 0)
+        size = 1;
+
+    // Any block in a class above the request's own is big enough; within its own class it may not be, so that one
+    // is only searched when nothing bigger is left
+    int first = sizeClass(size);
+    uint64_t candidates = first + 1 < SIZE_CLASSES ? nonEmptyClasses & (~0ULL << (first + 1)) : 0;
+
+    std::map<size_t, size_t>::iterator block = freeByOffset.end();
+    if (candidates)
+    {
+        int k = __builtin_ctzll(candidates);
+        block = freeByOffset.find(*classes[k].begin());
+    }
+    else
+    {
+        const std::set<size_t> &sameClass = classes[first];
+        for (std::set<size_t>::const_iterator it = sameClass.begin(); it != sameClass.end(); ++it)
+        {
+            std::map<size_t, size_t>::iterator candidate = freeByOffset.find(*it);
+            if (candidate->second >= size)
+            {
+                block = candidate;
+                break;
+            }
+        }
+    }
+
+    if (block == freeByOffset.end())
+        return false;
+
+    offset = block->first;
+    size_t remaining = block->second - size;
+    removeFree(block);
+    if (remaining)
+        insertFree(offset + size, remaining);
+
+    used += size;
+    return true;
+}
+
+void ArenaAllocator::free(size_t offset, size_t size)
+{
+    if (size == 0)
+        size = 1;
+    used -= size;
+
+    // Merge with the free ranges right before and right after
+    std::map<size_t, size_t>::iterator next = freeByOffset.lower_bound(offset);
+    if (next != freeByOffset.begin())
+    {
+        std::map<size_t, size_t>::iterator previous = next;
+        --previous;
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            removeFree(previous);
+        }
+    }
+
+    if (next != freeByOffset.end() && offset + size == next->first)
+    {
+        size += next->second;
+        removeFree(next);
+    }
+
+    insertFree(offset, size);
+}
+
+ArenaStats ArenaAllocator::stats() const
+{
+    ArenaStats stats = {capacity, used, freeByOffset.size(), 0};
+    for (std::map<size_t, size_t>::const_iterator it = freeByOffset.begin(); it != freeByOffset.end(); ++it)
+        if (it->second > stats.largestFree)
+            stats.largestFree = it->second;
+    return stats;
+}
+
+void ArenaAllocator::insertFree(size_t offset, size_t size)
+{
+    int k = sizeClass(size);
+    freeByOffset[offset] = size;
+    classes[k].insert(offset);
+    nonEmptyClasses |= 1ULL << k;
+}
+
+void ArenaAllocator::removeFree(std::map<size_t, size_t>::iterator block)
+{
+    int k = sizeClass(block->second);
+    classes[k].erase(block->first);
+    if (classes[k].empty())
+        nonEmptyClasses &= ~(1ULL << k);
+    freeByOffset.erase(block);
+}
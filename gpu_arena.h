@@ -0,0 +1,57 @@
+#ifndef GPU_ARENA_H
+#define GPU_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <set>
+
+struct ArenaStats
+{
+    size_t capacity;     // Units the arena holds
+    size_t used;         // Units handed out
+    size_t freeBlocks;   // Free ranges between and after allocations
+    size_t largestFree;  // Biggest request that can still be met
+};
+
+// Fragmentation of the free space, from 0 (one contiguous block) towards 1 (scattered small holes)
+inline double arenaFragmentation(const ArenaStats &stats)
+{
+    size_t free = stats.capacity - stats.used;
+    return free ? 1.0 - (double)stats.largestFree / (double)free : 0.0;
+}
+
+// Offset allocator for sub-allocating a buffer object
+// ---------------------------------------------------
+// Hands out ranges of a fixed capacity, counted in whatever unit the caller uses (vertices, indices). Free ranges
+// are kept in power-of-two size classes, so finding one that fits only looks at a class whose blocks are all big
+// enough; a bitmap of non-empty classes skips the rest. Freed ranges are merged with free neighbours right away.
+class ArenaAllocator
+{
+public:
+    static const int SIZE_CLASSES = 64;
+
+    explicit ArenaAllocator(size_t capacity);
+
+    // Reserve size units; returns false if no free range is big enough
+    bool allocate(size_t size, size_t &offset);
+
+    // Give back a range returned by allocate(), with the size it was allocated with
+    void free(size_t offset, size_t size);
+
+    ArenaStats stats() const;
+
+private:
+    static int sizeClass(size_t size);
+
+    void insertFree(size_t offset, size_t size);
+    void removeFree(std::map<size_t, size_t>::iterator block);
+
+    size_t capacity;
+    size_t used;
+    std::map<size_t, size_t> freeByOffset; // Offset to size, for merging neighbours
+    std::set<size_t> classes[SIZE_CLASSES]; // Offsets of the free ranges of size [2^k, 2^(k+1))
+    uint64_t nonEmptyClasses;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "gpu_timers.h"
+
+GpuTimerRing::GpuTimerRing(int frameCount, int stampCount) : frames(frameCount), stamps(stampCount)
+{
+    queries.resize(frames * stamps);
+    glGenQueries((GLsizei)queries.size(), queries.data());
+    tags.assign(frames, 0);
+    next = pending = 0;
+    calls = 0;
+}
+
+GpuTimerRing::~GpuTimerRing()
+{
+    glDeleteQueries((GLsizei)queries.size(), queries.data());
+}
+
+void GpuTimerRing::stamp(int index)
+{
+    // The oldest frame is in the slot that is about to be reused; it is dropped rather than waited on
+    if (index == 0 && pending == frames)
+        pending--;
+
+    glQueryCounter(queries[next * stamps + index], GL_TIMESTAMP);
+    calls++;
+}
+
+void GpuTimerRing::endFrame(long long tag)
+{
+    tags[next] = tag;
+    pending++;
+    next = (next + 1) % frames;
+}
+
+bool GpuTimerRing::read(GLuint64 *result, long long *tag, bool wait)
+{
+    if (pending == 0)
+        return false;
+
+    // Stamps land in the order they were issued, so the frame's last one stands for all of them
+    int oldest = (next - pending + frames) % frames;
+    const GLuint *slot = &queries[oldest * stamps];
+    if (!wait)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(slot[stamps - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        calls++;
+        if (!available)
+            return false;
+    }
+
+    for (int i = 0; i < stamps; i++)
+        glGetQueryObjectui64v(slot[i], GL_QUERY_RESULT, &result[i]);
+    calls += stamps;
+
+    if (tag)
+        *tag = tags[oldest];
+    pending--;
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef GPU_TIMERS_H
+#define GPU_TIMERS_H
+
+#include <glad/glad.h>
+#include <vector>
+
+// Ring of GPU timestamp queries
+// -----------------------------
+// Every slot holds the GL_TIMESTAMP queries of one frame, stampCount of them, and the slots are used in turn, so up
+// to frameCount frames are in flight at once. Frames are read back oldest first and only once their last stamp has
+// landed, so reading never makes the CPU wait unless asked to; a frame still outstanding when its slot comes round
+// again is dropped. Every frame carries a tag for the caller to tell its frames apart. Must be created and used on
+// the thread that owns the context.
+class GpuTimerRing
+{
+public:
+    GpuTimerRing(int frameCount, int stampCount);
+    ~GpuTimerRing();
+
+    // Issue the frame's index-th timestamp; stamp 0 starts the frame in the next slot
+    void stamp(int index);
+
+    // After the frame's last stamp: it is read back under tag
+    void endFrame(long long tag = 0);
+
+    // Take the oldest finished frame's stamps, in nanoseconds, and tag; false if there is none. With wait, block on
+    // the oldest outstanding frame rather than skip it.
+    bool read(GLuint64 *result, long long *tag = NULL, bool wait = false);
+
+    // Whether starting another frame would drop one still outstanding
+    bool full() const
+    {
+        return pending == frames;
+    }
+
+    // GL calls made so far, for the caller's counts
+    unsigned long long glCalls() const
+    {
+        return calls;
+    }
+
+private:
+    int frames, stamps;
+    std::vector<GLuint> queries; // stamps per slot, slot after slot
+    std::vector<long long> tags;
+    int next;    // Slot of the frame being stamped, or of the next one to be
+    int pending; // Ended frames not yet read, in the slots before next
+    unsigned long long calls;
+};
+
+#endif
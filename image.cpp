@@ -0,0 +1,123 @@
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+bool writePPM(const char *path, const Image &image)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+
+    std::vector<unsigned char> row(3 * image.width);
+    for (int y = image.height - 1; y >= 0; y--)
+    {
+        const unsigned char *source = &image.pixels[4 * y * image.width];
+        for (int x = 0; x < image.width; x++)
+        {
+            row[3 * x] = source[4 * x];
+            row[3 * x + 1] = source[4 * x + 1];
+            row[3 * x + 2] = source[4 * x + 2];
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+
+    return fclose(file) == 0;
+}
+
+bool readPPM(const char *path, Image &image)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    int width, height, maxValue;
+    if (fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) != 3 || maxValue != 255 || width <= 0 || height <= 0 ||
+        fgetc(file) == EOF)
+    {
+        fclose(file);
+        return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(4 * width * height);
+
+    std::vector<unsigned char> row(3 * width);
+    for (int y = height - 1; y >= 0; y--)
+    {
+        if (fread(row.data(), 1, row.size(), file) != row.size())
+        {
+            fclose(file);
+            return false;
+        }
+
+        unsigned char *target = &image.pixels[4 * y * width];
+        for (int x = 0; x < width; x++)
+        {
+            target[4 * x] = row[3 * x];
+            target[4 * x + 1] = row[3 * x + 1];
+            target[4 * x + 2] = row[3 * x + 2];
+            target[4 * x + 3] = 255;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+ImageDifference compareImages(const Image &a, const Image &b, int tolerance)
+{
+    ImageDifference difference = {0, 0};
+    int count = a.width * a.height;
+    int i = 0;
+
+#ifdef __SSE2__
+    // |a - b| per byte from two saturating subtractions; a pixel differs when any of its RGB bytes is still non-zero
+    // after the tolerance is subtracted, which is one 32-bit lane compare per pixel
+    static const int okPixels[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i limit = _mm_set1_epi8((char)tolerance);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i largest = zero;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i pa = _mm_loadu_si128((const __m128i *)&a.pixels[4 * i]);
+        __m128i pb = _mm_loadu_si128((const __m128i *)&b.pixels[4 * i]);
+        __m128i delta = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(pa, pb), _mm_subs_epu8(pb, pa)), rgb);
+
+        largest = _mm_max_epu8(largest, delta);
+        __m128i within = _mm_cmpeq_epi32(_mm_subs_epu8(delta, limit), zero);
+        difference.differingPixels += 4 - okPixels[_mm_movemask_ps(_mm_castsi128_ps(within))];
+    }
+
+    unsigned char lanes[16];
+    _mm_storeu_si128((__m128i *)lanes, largest);
+    for (int k = 0; k < 16; k++)
+        if (lanes[k] > difference.maxDifference)
+            difference.maxDifference = lanes[k];
+#endif
+
+    for (; i < count; i++)
+    {
+        bool differs = false;
+        for (int k = 0; k < 3; k++)
+        {
+            int delta = abs((int)a.pixels[4 * i + k] - (int)b.pixels[4 * i + k]);
+            if (delta > difference.maxDifference)
+                difference.maxDifference = delta;
+            if (delta > tolerance)
+                differs = true;
+        }
+        if (differs)
+            difference.differingPixels++;
+    }
+
+    return difference;
+}
@@ -0,0 +1,28 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <vector>
+
+// RGBA8 image with rows stored bottom-up, the same layout glReadPixels produces
+struct Image
+{
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+// How far apart two images of the same size are, over the RGB channels
+struct ImageDifference
+{
+    int differingPixels; // Pixels where any channel differs by more than the tolerance
+    int maxDifference;   // Largest difference in any single channel
+};
+
+// Binary PPM (P6), written top-down as the format expects
+bool writePPM(const char *path, const Image &image);
+bool readPPM(const char *path, Image &image);
+
+// Compare two images of the same size 4 pixels at a time; alpha is ignored
+ImageDifference compareImages(const Image &a, const Image &b, int tolerance);
+
+#endif
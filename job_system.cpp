@@ -0,0 +1,214 @@
+#include "job_system.h"
+
+JobSystem *jobSystem = NULL;
+
+// Which pool and which deque the current thread works for, if any
+static thread_local JobSystem *currentSystem = NULL;
+static thread_local unsigned int currentWorker = 0;
+
+JobSystem::JobSystem(unsigned int workerCount)
+{
+    if (workerCount == 0)
+        workerCount = 1;
+
+    for (unsigned int i = 0; i < workerCount; i++)
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+
+    for (unsigned int i = 0; i < workerCount; i++)
+        workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCondition.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+JobHandle JobSystem::create(std::function<void()> task)
+{
+    JobHandle job = std::make_shared<Job>();
+    job->task = std::move(task);
+    return job;
+}
+
+void JobSystem::addDependency(const JobHandle &job, const JobHandle &prerequisite)
+{
+    job->pendingDependencies.fetch_add(1);
+
+    std::lock_guard<std::mutex> lock(prerequisite->dependentsMutex);
+    if (prerequisite->finished.load())
+        job->pendingDependencies.fetch_sub(1);
+    else
+        prerequisite->dependents.push_back(job);
+}
+
+void JobSystem::submit(const JobHandle &job)
+{
+    release(job);
+}
+
+void JobSystem::wait(const JobHandle &job)
+{
+    bool isWorker = currentSystem == this;
+
+    while (!job->finished.load())
+    {
+        JobHandle next = isWorker ? pop(currentWorker) : JobHandle();
+        if (!next)
+            next = steal(isWorker ? currentWorker : (unsigned int)queues.size());
+
+        if (next)
+        {
+            execute(next);
+            continue;
+        }
+
+        // Nothing to help with: sleep until some job finishes or new work shows up
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        finishedCondition.wait(lock, [&] { return job->finished.load() || queuedJobs.load() > 0; });
+    }
+}
+
+JobHandle JobSystem::parallelForAsync(int begin, int end, int grainSize, std::function<void(int, int)> body)
+{
+    JobHandle done = create(std::function<void()>());
+
+    if (grainSize < 1)
+        grainSize = 1;
+
+    std::shared_ptr<std::function<void(int, int)>> shared = std::make_shared<std::function<void(int, int)>>(std::move(body));
+    for (int chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+    {
+        int chunkEnd = end - chunkBegin > grainSize ? chunkBegin + grainSize : end;
+        JobHandle chunk = create([shared, chunkBegin, chunkEnd] { (*shared)(chunkBegin, chunkEnd); });
+
+        addDependency(done, chunk);
+        submit(chunk);
+    }
+
+    submit(done);
+    return done;
+}
+
+void JobSystem::parallelFor(int begin, int end, int grainSize, std::function<void(int, int)> body)
+{
+    wait(parallelForAsync(begin, end, grainSize, std::move(body)));
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+    currentSystem = this;
+    currentWorker = index;
+
+    while (true)
+    {
+        JobHandle job = pop(index);
+        if (!job)
+            job = steal(index);
+
+        if (job)
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this] { return stopping.load() || queuedJobs.load() > 0; });
+        if (stopping.load() && queuedJobs.load() == 0)
+            return;
+    }
+}
+
+// Workers push onto their own deque, everybody else spreads work round-robin
+void JobSystem::push(const JobHandle &job)
+{
+    unsigned int index;
+    if (currentSystem == this)
+        index = currentWorker;
+    else
+        index = nextQueue.fetch_add(1) % queues.size();
+
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->jobs.push_back(job);
+    }
+    queuedJobs.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+    finishedCondition.notify_all();
+}
+
+// The owner takes its most recently pushed job, which is the one most likely to still be in cache
+JobHandle JobSystem::pop(unsigned int index)
+{
+    WorkerQueue &queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty())
+        return JobHandle();
+
+    JobHandle job = queue.jobs.back();
+    queue.jobs.pop_back();
+    queuedJobs.fetch_sub(1);
+    return job;
+}
+
+// Thieves take the oldest job of some other worker, which tends to be the biggest remaining piece of work
+JobHandle JobSystem::steal(unsigned int thief)
+{
+    size_t count = queues.size();
+    for (size_t i = 1; i <= count; i++)
+    {
+        size_t victim = (thief + i) % count;
+        if (victim == thief)
+            continue;
+
+        WorkerQueue &queue = *queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+
+        JobHandle job = queue.jobs.front();
+        queue.jobs.pop_front();
+        queuedJobs.fetch_sub(1);
+        return job;
+    }
+
+    return JobHandle();
+}
+
+void JobSystem::execute(const JobHandle &job)
+{
+    if (job->task)
+        job->task();
+
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(job->dependentsMutex);
+        job->finished = true;
+        dependents.swap(job->dependents);
+    }
+
+    for (size_t i = 0; i < dependents.size(); i++)
+        release(dependents[i]);
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    finishedCondition.notify_all();
+}
+
+// Drop one outstanding dependency and queue the job once there are none left
+void JobSystem::release(const JobHandle &job)
+{
+    if (job->pendingDependencies.fetch_sub(1) == 1)
+        push(job);
+}
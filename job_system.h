@@ -0,0 +1,83 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A unit of work plus the jobs that have to wait for it
+struct Job
+{
+    std::function<void()> task;
+    std::atomic<int> pendingDependencies{1}; // The extra 1 is released by submit()
+    std::atomic<bool> finished{false};
+    std::mutex dependentsMutex;
+    std::vector<std::shared_ptr<Job>> dependents;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Work-stealing thread pool
+// -------------------------
+// Every worker owns a deque: it pushes and pops work at the back, and idle workers steal from the front of the
+// others. Jobs can depend on other jobs and only become runnable once all of their prerequisites have finished.
+// Threads that wait on a job help out by running queued work instead of blocking.
+class JobSystem
+{
+public:
+    explicit JobSystem(unsigned int workerCount);
+    ~JobSystem();
+
+    unsigned int workerCount() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    JobHandle create(std::function<void()> task);
+
+    // Make job wait for prerequisite; must be called before job is submitted
+    void addDependency(const JobHandle &job, const JobHandle &prerequisite);
+
+    // Queue the job as soon as all of its dependencies have finished
+    void submit(const JobHandle &job);
+
+    // Run queued jobs on the calling thread until the given job has finished
+    void wait(const JobHandle &job);
+
+    // Split [begin, end) into chunks of at most grainSize and run body(chunkBegin, chunkEnd) on each of them.
+    // The returned job finishes once every chunk has; it can be waited on or used as a dependency.
+    JobHandle parallelForAsync(int begin, int end, int grainSize, std::function<void(int, int)> body);
+    void parallelFor(int begin, int end, int grainSize, std::function<void(int, int)> body);
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    void workerLoop(unsigned int index);
+    void push(const JobHandle &job);
+    JobHandle pop(unsigned int index);
+    JobHandle steal(unsigned int thief);
+    void execute(const JobHandle &job);
+    void release(const JobHandle &job);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<int> queuedJobs{0};
+    std::atomic<unsigned int> nextQueue{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::condition_variable finishedCondition;
+};
+
+extern JobSystem *jobSystem;
+
+#endif
@@ -0,0 +1,93 @@
+#include "latency.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "simulation.h"
+
+// Swaps between measurements of the offset between the GPU and CPU clocks, which drift apart slowly
+const unsigned int LATENCY_CALIBRATION_INTERVAL = 256;
+
+LatencyStats latencyStats(std::vector<double> samples)
+{
+    LatencyStats stats = LatencyStats();
+    stats.count = samples.size();
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+    double total = 0.0;
+    for (size_t i = 0; i < samples.size(); i++)
+        total += samples[i];
+
+    // Nearest-rank percentiles
+    size_t n = samples.size();
+    stats.meanMs = total / n;
+    stats.p50Ms = samples[(n * 50 + 99) / 100 - 1];
+    stats.p90Ms = samples[(n * 90 + 99) / 100 - 1];
+    stats.p99Ms = samples[(n * 99 + 99) / 100 - 1];
+    stats.maxMs = samples[n - 1];
+    return stats;
+}
+
+void printLatencyStats(const char *label, const LatencyStats &stats)
+{
+    std::cout << label << ": " << stats.count << " presses, mean " << std::fixed << std::setprecision(2) << stats.meanMs
+              << " ms, p50 " << stats.p50Ms << " ms, p90 " << stats.p90Ms << " ms, p99 " << stats.p99Ms << " ms, max "
+              << stats.maxMs << " ms" << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+LatencyTracker::LatencyTracker()
+{
+    lastInputTime = 0;
+    swapsSinceCalibration = 0;
+    timers = new GpuTimerRing(MAX_PENDING, 1);
+    calibrate();
+}
+
+LatencyTracker::~LatencyTracker()
+{
+    delete timers;
+}
+
+// Read the GPU clock between two reads of the CPU clock and take the midpoint
+void LatencyTracker::calibrate()
+{
+    GLint64 gpuNow = 0;
+    long long before = inputTimestamp();
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    long long after = inputTimestamp();
+
+    gpuToCpu = before + (after - before) / 2 - (long long)gpuNow;
+    swapsSinceCalibration = 0;
+}
+
+void LatencyTracker::frameSwapped(long long inputTime)
+{
+    if (++swapsSinceCalibration >= LATENCY_CALIBRATION_INTERVAL)
+        calibrate();
+
+    // Redrawing the same snapshot shows nothing new
+    if (inputTime == 0 || inputTime == lastInputTime)
+        return;
+    lastInputTime = inputTime;
+    inputTimeShown.store(inputTime, std::memory_order_relaxed);
+
+    swapMs.push_back((inputTimestamp() - inputTime) / 1e6);
+
+    // Too many frames in flight: they have to be read now rather than have the oldest dropped
+    if (timers->full())
+        poll(true);
+
+    timers->stamp(0);
+    timers->endFrame(inputTime);
+}
+
+void LatencyTracker::poll(bool wait)
+{
+    GLuint64 finished = 0;
+    long long inputTime = 0;
+    while (timers->read(&finished, &inputTime, wait))
+        gpuMs.push_back(((long long)finished + gpuToCpu - inputTime) / 1e6);
+}
@@ -0,0 +1,66 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <glad/glad.h>
+#include <stddef.h>
+#include <vector>
+#include "gpu_timers.h"
+
+// Distribution of one latency, in milliseconds
+struct LatencyStats
+{
+    size_t count;
+    double meanMs;
+    double p50Ms, p90Ms, p99Ms, maxMs;
+};
+
+LatencyStats latencyStats(std::vector<double> samples);
+
+// One line: the label, then the count, mean, percentiles and maximum
+void printLatencyStats(const char *label, const LatencyStats &stats);
+
+// Input-to-photon latency
+// -----------------------
+// Times key presses to the first frame that shows them. The simulation stamps every press and hands the stamp on
+// in the snapshot of the first tick that reacts to it (FrameSnapshot::inputTime); once that frame has been swapped,
+// a timestamp query issued right after the swap tells when the GPU finished it, which is as close to the photons
+// as GL can see: the frame then waits for the display's next refresh at most. The query is read once its result is
+// in, a few frames later, and GPU time is converted to the CPU's steady clock with an offset measured every so
+// often. The time at which glfwSwapBuffers() returned is kept as well. Must be used on the thread that owns the
+// context.
+class LatencyTracker
+{
+public:
+    static const int MAX_PENDING = 16; // Frames whose queries may be outstanding at once
+
+    LatencyTracker();
+    ~LatencyTracker();
+
+    // Right after glfwSwapBuffers() returned for a frame drawn from a snapshot with this inputTime
+    void frameSwapped(long long inputTime);
+
+    // Take in the frames whose queries have finished; with wait, block until all of them have
+    void poll(bool wait = false);
+
+    // Key press to glfwSwapBuffers() returning, and to the GPU finishing the frame
+    LatencyStats swapStats() const
+    {
+        return latencyStats(swapMs);
+    }
+
+    LatencyStats gpuStats() const
+    {
+        return latencyStats(gpuMs);
+    }
+
+private:
+    void calibrate();
+
+    long long lastInputTime;
+    long long gpuToCpu; // Added to a GPU timestamp to get inputTimestamp() time
+    unsigned int swapsSinceCalibration;
+    GpuTimerRing *timers; // One stamp per frame, tagged with its inputTime
+    std::vector<double> swapMs, gpuMs;
+};
+
+#endif
@@ -3,59 +3,213 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
+#include <thread>
 #include <time.h>
+#include <vector>
+#include "benchmarks.h"
+#include "dynamic_resolution.h"
+#include "frame_pacer.h"
+#include "golden.h"
+#include "image.h"
+#include "job_system.h"
+#include "latency.h"
+#include "mesh_cache.h"
+#include "mesh_export.h"
+#include "picking.h"
+#include "prism.h"
+#include "simulation.h"
+#include "render_targets.h"
+#include "renderer.h"
+#include "scene.h"
+#include "software_rasterizer.h"
+#include "stats_overlay.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
-void processInput(GLFWwindow *window);
-void reset();
 void key_was_pressed(GLFWwindow *window, int key, int scancode, int action, int mods);
-void generateColor(float &r, float &g, float &b);
+void window_refresh_callback(GLFWwindow *window);
+void mouse_button_pressed(GLFWwindow *window, int button, int action, int mods);
+
+// How the window renders, from the command line
+struct RenderOptions
+{
+    const char *meshCache;
+    bool measureOverdraw;
+    bool occlusionCulling;
+    PacingOptions pacing;
+    double gpuBudgetMs; // Scale the render resolution to keep the scene's GPU time within this; 0 for off
+};
+
+void renderLoop(GLFWwindow *window, const Scene *scene, PrismBVH *bvh, RenderOptions options);
+int renderSoftware(const MeshView &mesh, const char *path);
 
 // Settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 800;
-bool OBJECT_SET_TO_ROTATE = false;
-bool CAMERA_SET_TO_REVOLVE = false;
-bool PREVIOUS_WAS_TRANSLATE = false;
-
-glm::mat4 model = glm::mat4(1.0f);
-glm::mat4 view;
-glm::vec3 origin = glm::vec3(0.0f, 0.0f, 0.0f);
-glm::vec3 c = glm::vec3(0.0f, 0.0f, 0.0f);
-glm::vec3 cameraPos = glm::vec3(c.x, c.y, c.z + 3.0f);
-glm::vec3 cameraTarget = glm::vec3(c.x, c.y, c.z);
-glm::vec3 cameraFront = cameraTarget - cameraPos;
-glm::vec3 cameraUp = glm::vec3(c.x, c.y + 1.0f, c.z);
-glm::mat4 identity = glm::mat4(1.0f);
-float angle = 0.0f;
-
-const char *vertexShaderSource = "#version 330 core\n"
-                                 "layout (location = 0) in vec3 aPos;\n"
-                                 "layout (location = 1) in vec3 aColor;\n"
-                                 "uniform mat4 model;\n"
-                                 "uniform mat4 view;\n"
-                                 "uniform mat4 projection;\n"
-                                 "out vec3 inColor;\n"
-                                 "void main()\n"
-                                 "{\n"
-                                 "   gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
-                                 "   inColor = aColor;\n"
-                                 "}\0";
-
-const char *fragmentShaderSource = "#version 330 core\n"
-                                   "out vec4 FragColor;\n"
-                                   "in vec3 inColor;\n"
-                                   "void main()\n"
-                                   "{\n"
-                                   "   FragColor = vec4(inColor, 1.0f);\n"
-                                   "}\n\0";
+
+// Offscreen targets are only reallocated once the window has kept its size this long, so a drag-resize does not
+// allocate at every step; until then frames are drawn within the targets there are
+const std::chrono::milliseconds RESIZE_SETTLE_TIME(150);
+
+// Render thread state, written by the GLFW callbacks on the main thread
+std::atomic<int> framebufferWidth(SCR_WIDTH);
+std::atomic<int> framebufferHeight(SCR_HEIGHT);
+std::atomic<bool> VIEWPORT_CHANGED(false);
+std::atomic<bool> REDRAW_REQUESTED(false);
+std::atomic<bool> PICK_REQUESTED(false);
+std::atomic<bool> STATS_VISIBLE(true); // F3 toggles the statistics overlay
+std::atomic<float> pickX(0.0f), pickY(0.0f); // Cursor position of the last click, in [0, 1] from the top left
 
 int main(int argc, char *argv[])
 {
-    srand(time(0));
-    int n = atoi(argv[1]);
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <n> [--seed <seed>] [--mesh-cache <dir>] [--export <output.obj|.glb>] [--software <output.ppm>] [--overdraw] [--hiz] [--gpu-budget <ms>] [pacing]\n"
+                  << "       " << argv[0] << " --scene <file> [--save-scene <output>] [--software <output.ppm>] [--overdraw] [--hiz] [--gpu-budget <ms>] [pacing]\n"
+                  << "       pacing: [--frames-in-flight <n>] [--fps-cap <fps>] [--low-latency]\n"
+                  << "       " << argv[0] << " --bench <name>\n"
+                  << "       " << argv[0] << " --golden record|budgets|check <dir> [software|gl]" << std::endl;
+        return -1;
+    }
+
+    if (strcmp(argv[1], "--bench") == 0)
+        return runBenchmark(argc > 2 ? argv[2] : "");
+    if (strcmp(argv[1], "--golden") == 0)
+        return runGoldenSuite(argc > 2 ? argv[2] : "", argc > 3 ? argv[3] : ".", argc > 4 ? argv[4] : "software");
+
+    // Either one prism of n sides, or every prism listed in a scene file
+    const char *scenePath = NULL;
+    int n = 0;
+    int firstOption = 2;
+
+    if (strcmp(argv[1], "--scene") == 0 && argc > 2)
+    {
+        scenePath = argv[2];
+        firstOption = 3;
+    }
+    else
+        n = atoi(argv[1]);
+
+    uint32_t seed = (uint32_t)time(0);
+    const char *softwareOutput = NULL;
+    const char *meshCache = NULL;
+    const char *exportPath = NULL;
+    const char *savedScene = NULL;
+    bool measureOverdraw = false;
+    bool occlusionCulling = false;
+    PacingOptions pacing = {2, 0.0, false};
+    double gpuBudgetMs = 0.0;
+
+    for (int i = firstOption; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--mesh-cache") == 0 && i + 1 < argc)
+            meshCache = argv[++i];
+        else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc)
+            exportPath = argv[++i];
+        else if (strcmp(argv[i], "--save-scene") == 0 && i + 1 < argc)
+            savedScene = argv[++i];
+        else if (strcmp(argv[i], "--software") == 0 && i + 1 < argc)
+            softwareOutput = argv[++i];
+        else if (strcmp(argv[i], "--overdraw") == 0)
+            measureOverdraw = true;
+        else if (strcmp(argv[i], "--hiz") == 0)
+            occlusionCulling = true;
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+            pacing.maxFramesInFlight = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fps-cap") == 0 && i + 1 < argc)
+            pacing.fpsCap = atof(argv[++i]);
+        else if (strcmp(argv[i], "--low-latency") == 0)
+            pacing.lowLatency = true;
+        else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc)
+            gpuBudgetMs = atof(argv[++i]);
+    }
+
+    if (!scenePath && n < 3)
+    {
+        std::cout << "A prism needs at least 3 sides" << std::endl;
+        return -1;
+    }
+
+    // The OBJ writer relies on the layout of a single prism; refuse before a scene is loaded and baked for nothing
+    if (scenePath && exportPath)
+    {
+        std::cout << "--export takes a single prism, not a scene" << std::endl;
+        return -1;
+    }
+
+    // Face colours are a pure function of the seed, so printing it is enough to get the same prism again
+    if (!scenePath)
+        std::cout << "Colour seed: " << seed << std::endl;
+
+    // Worker threads for geometry generation, scene update and software rasterisation jobs
+    unsigned int cores = std::thread::hardware_concurrency();
+    JobSystem jobs(cores > 1 ? cores - 1 : 1);
+    jobSystem = &jobs;
+
+    // Set up the scene
+    // ----------------
+    // A single prism is a scene of one
+    Scene scene;
+
+    if (scenePath)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!loadScene(scenePath, scene, *jobSystem))
+            return -1;
+
+        std::cout << "Scene: " << scene.prisms.size() << " prisms loaded in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+                  << std::endl;
+
+        if (savedScene)
+        {
+            if (!saveSceneBinary(savedScene, scene))
+            {
+                std::cout << "Failed to write " << savedScene << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+    }
+    else
+        singlePrismScene(n, seed, c, scene);
+
+    // Set up vertex data
+    // ------------------
+    // Exporting and the software path work on one coloured mesh: a cached shape is mapped and coloured, otherwise
+    // it is generated and cached for the next run. Scenes are baked into one world-space mesh.
+    if (exportPath || softwareOutput)
+    {
+        PrismMesh generatedMesh;
+        MappedMesh cachedMesh;
+        MeshView mesh;
+
+        if (scenePath)
+        {
+            buildSceneMesh(scene, generatedMesh, *jobSystem);
+            mesh = meshView(generatedMesh);
+        }
+        else
+            mesh = cachedPrism(meshCache, n, seed, c, generatedMesh, cachedMesh, *jobSystem);
+
+        if (exportPath)
+        {
+            if (!exportMesh(exportPath, n, mesh))
+            {
+                std::cout << "Failed to export " << exportPath << " (expected an .obj or .glb path)" << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+
+        return renderSoftware(mesh, softwareOutput);
+    }
 
     // GLFW: Initialize and configure
     // ------------------------------
@@ -80,6 +234,12 @@ int main(int argc, char *argv[])
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
+    // The framebuffer can be larger than the window on high-DPI displays, and no size callback reports it at first
+    int initialWidth, initialHeight;
+    glfwGetFramebufferSize(window, &initialWidth, &initialHeight);
+    framebuffer_size_callback(window, initialWidth, initialHeight);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+
     // GLAD: Load all OpenGL function pointers
     // ---------------------------------------
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -88,292 +248,38 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    // Build and compile our shader program
-    // ------------------------------------
-    // Vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    // Check for shader compile errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-
-    if (!success)
-    {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
-    }
-    // Fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    // Check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
-    }
-
-    // Link shaders
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // Check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
-                  << infoLog << std::endl;
-    }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // Set up vertex data (and buffer(s)) and configure vertex attributes
-    // ------------------------------------------------------------------
-    float points[2 * n][3];
-    float vertices[36 * (n - 2) + 36 * n];
-    float r, g, b;
-
-    // Storing points
-    for (int i = 0; i < n; i++)
-    {
-        points[i][0] = c.x + cos(2 * M_PI * i / n) * 0.5f;
-        points[i][1] = c.y + sin(2 * M_PI * i / n) * 0.5f;
-        points[i][2] = c.z + 0.5f;
-    }
-
-    for (int i = 0; i < n; i++)
-    {
-        points[n + i][0] = c.x + cos(2 * M_PI * i / n) * 0.5f;
-        points[n + i][1] = c.y + sin(2 * M_PI * i / n) * 0.5f;
-        points[n + i][2] = c.z - 0.5f;
-    }
-
-    // Generating figure
-    generateColor(r, g, b);
-
-    for (int i = 0; i < n - 2; i++)
-    {
-        vertices[18 * i] = points[0][0];
-        vertices[18 * i + 1] = points[0][1];
-        vertices[18 * i + 2] = points[0][2];
-        vertices[18 * i + 3] = r;
-        vertices[18 * i + 4] = g;
-        vertices[18 * i + 5] = b;
-
-        vertices[18 * i + 6] = points[i + 1][0];
-        vertices[18 * i + 7] = points[i + 1][1];
-        vertices[18 * i + 8] = points[i + 1][2];
-        vertices[18 * i + 9] = r;
-        vertices[18 * i + 10] = g;
-        vertices[18 * i + 11] = b;
-
-        vertices[18 * i + 12] = points[i + 2][0];
-        vertices[18 * i + 13] = points[i + 2][1];
-        vertices[18 * i + 14] = points[i + 2][2];
-        vertices[18 * i + 15] = r;
-        vertices[18 * i + 16] = g;
-        vertices[18 * i + 17] = b;
-    }
-
-    generateColor(r, g, b);
+    glfwSetKeyCallback(window, key_was_pressed);
+    glfwSetMouseButtonCallback(window, mouse_button_pressed);
 
-    for (int i = 0; i < n - 2; i++)
-    {
-        vertices[18 * (n - 2) + 18 * i] = points[n][0];
-        vertices[18 * (n - 2) + 18 * i + 1] = points[n][1];
-        vertices[18 * (n - 2) + 18 * i + 2] = points[n][2];
-        vertices[18 * (n - 2) + 18 * i + 3] = r;
-        vertices[18 * (n - 2) + 18 * i + 4] = g;
-        vertices[18 * (n - 2) + 18 * i + 5] = b;
-
-        vertices[18 * (n - 2) + 18 * i + 6] = points[i + 1 + n][0];
-        vertices[18 * (n - 2) + 18 * i + 7] = points[i + 1 + n][1];
-        vertices[18 * (n - 2) + 18 * i + 8] = points[i + 1 + n][2];
-        vertices[18 * (n - 2) + 18 * i + 9] = r;
-        vertices[18 * (n - 2) + 18 * i + 10] = g;
-        vertices[18 * (n - 2) + 18 * i + 11] = b;
-
-        vertices[18 * (n - 2) + 18 * i + 12] = points[i + 2 + n][0];
-        vertices[18 * (n - 2) + 18 * i + 13] = points[i + 2 + n][1];
-        vertices[18 * (n - 2) + 18 * i + 14] = points[i + 2 + n][2];
-        vertices[18 * (n - 2) + 18 * i + 15] = r;
-        vertices[18 * (n - 2) + 18 * i + 16] = g;
-        vertices[18 * (n - 2) + 18 * i + 17] = b;
-    }
+    // Clicking picks the prism under the cursor
+    PrismBVH bvh;
+    std::chrono::steady_clock::time_point bvhStart = std::chrono::steady_clock::now();
+    bvh.build(scene);
+    std::cout << "Picking BVH: " << bvh.nodeCount() << " nodes, depth " << bvh.depth() << ", built in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhStart).count() << " ms"
+              << std::endl;
 
-    for (int i = 0; i < n - 1; i++)
-    {
-        generateColor(r, g, b);
-
-        int beg = i, end = i + n + 1;
-        vertices[36 * (n - 2) + 36 * i] = points[beg][0];
-        vertices[36 * (n - 2) + 36 * i + 1] = points[beg][1];
-        vertices[36 * (n - 2) + 36 * i + 2] = points[beg][2];
-        vertices[36 * (n - 2) + 36 * i + 3] = r;
-        vertices[36 * (n - 2) + 36 * i + 4] = g;
-        vertices[36 * (n - 2) + 36 * i + 5] = b;
-
-        vertices[36 * (n - 2) + 36 * i + 6] = points[beg + 1][0];
-        vertices[36 * (n - 2) + 36 * i + 7] = points[beg + 1][1];
-        vertices[36 * (n - 2) + 36 * i + 8] = points[beg + 1][2];
-        vertices[36 * (n - 2) + 36 * i + 9] = r;
-        vertices[36 * (n - 2) + 36 * i + 10] = g;
-        vertices[36 * (n - 2) + 36 * i + 11] = b;
-
-        vertices[36 * (n - 2) + 36 * i + 12] = points[end][0];
-        vertices[36 * (n - 2) + 36 * i + 13] = points[end][1];
-        vertices[36 * (n - 2) + 36 * i + 14] = points[end][2];
-        vertices[36 * (n - 2) + 36 * i + 15] = r;
-        vertices[36 * (n - 2) + 36 * i + 16] = g;
-        vertices[36 * (n - 2) + 36 * i + 17] = b;
-
-        vertices[36 * (n - 2) + 36 * i + 18] = points[beg][0];
-        vertices[36 * (n - 2) + 36 * i + 19] = points[beg][1];
-        vertices[36 * (n - 2) + 36 * i + 20] = points[beg][2];
-        vertices[36 * (n - 2) + 36 * i + 21] = r;
-        vertices[36 * (n - 2) + 36 * i + 22] = g;
-        vertices[36 * (n - 2) + 36 * i + 23] = b;
-
-        vertices[36 * (n - 2) + 36 * i + 24] = points[end - 1][0];
-        vertices[36 * (n - 2) + 36 * i + 25] = points[end - 1][1];
-        vertices[36 * (n - 2) + 36 * i + 26] = points[end - 1][2];
-        vertices[36 * (n - 2) + 36 * i + 27] = r;
-        vertices[36 * (n - 2) + 36 * i + 28] = g;
-        vertices[36 * (n - 2) + 36 * i + 29] = b;
-
-        vertices[36 * (n - 2) + 36 * i + 30] = points[end][0];
-        vertices[36 * (n - 2) + 36 * i + 31] = points[end][1];
-        vertices[36 * (n - 2) + 36 * i + 32] = points[end][2];
-        vertices[36 * (n - 2) + 36 * i + 33] = r;
-        vertices[36 * (n - 2) + 36 * i + 34] = g;
-        vertices[36 * (n - 2) + 36 * i + 35] = b;
-    }
+    // The render thread takes the context over from here on
+    glfwMakeContextCurrent(NULL);
 
-    generateColor(r, g, b);
-
-    vertices[36 * (n - 2) + 36 * (n - 1)] = points[n - 1][0];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 1] = points[n - 1][1];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 2] = points[n - 1][2];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 3] = r;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 4] = g;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 5] = b;
-
-    vertices[36 * (n - 2) + 36 * (n - 1) + 6] = points[0][0];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 7] = points[0][1];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 8] = points[0][2];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 9] = r;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 10] = g;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 11] = b;
-
-    vertices[36 * (n - 2) + 36 * (n - 1) + 12] = points[n][0];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 13] = points[n][1];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 14] = points[n][2];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 15] = r;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 16] = g;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 17] = b;
-
-    vertices[36 * (n - 2) + 36 * (n - 1) + 18] = points[n - 1][0];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 19] = points[n - 1][1];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 20] = points[n - 1][2];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 21] = r;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 22] = g;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 23] = b;
-
-    vertices[36 * (n - 2) + 36 * (n - 1) + 24] = points[2 * n - 1][0];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 25] = points[2 * n - 1][1];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 26] = points[2 * n - 1][2];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 27] = r;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 28] = g;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 29] = b;
-
-    vertices[36 * (n - 2) + 36 * (n - 1) + 30] = points[n][0];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 31] = points[n][1];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 32] = points[n][2];
-    vertices[36 * (n - 2) + 36 * (n - 1) + 33] = r;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 34] = g;
-    vertices[36 * (n - 2) + 36 * (n - 1) + 35] = b;
-
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    // Bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    glEnable(GL_DEPTH_TEST);
+    // In a scene, rotate mode spins every prism where it stands
+    PRISMS_SPIN_IN_PLACE = scenePath != NULL;
 
-    glfwSetKeyCallback(window, key_was_pressed);
+    std::thread simulationThread(simulationLoop);
+    RenderOptions options = {meshCache, measureOverdraw, occlusionCulling, pacing, gpuBudgetMs};
+    std::thread renderThread(renderLoop, window, &scene, &bvh, options);
 
-    // Render loop
-    // -----------
+    // Event loop
+    // ----------
+    // The main thread only pumps GLFW events; it sleeps until the OS has something for us
     while (!glfwWindowShouldClose(window))
-    {
-        if (OBJECT_SET_TO_ROTATE)
-            angle += 0.05f;
-
-        model = glm::translate(identity, c);
-        model = glm::rotate(model, angle, glm::vec3(1.0f, 0.0f, 0.0f));
-
-        if (CAMERA_SET_TO_REVOLVE)
-            cameraPos += glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp)) * 0.05f;
-
-        // Input
-        // -----
-        processInput(window);
-
-        // Render
-        // ------
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        if (!PREVIOUS_WAS_TRANSLATE)
-            view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
-
-        glm::mat4 projection;
-        projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_WIDTH, 0.1f, 100.0f);
-
-        // Draw figure
-        glUseProgram(shaderProgram);
-        unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        unsigned int projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36 * (n - 2) + 36 * n);
-
-        // GLFW: Swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
+        glfwWaitEvents();
 
-    // De-allocate all resources once they've outlived their purpose:
-    // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
+    QUIT_REQUESTED = true;
+    inputEvent.notify();
+    frameEvent.notify();
+    simulationThread.join();
+    renderThread.join();
 
     // GLFW: Terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -381,171 +287,337 @@ int main(int argc, char *argv[])
     return 0;
 }
 
-// Generate random RGB values
-void generateColor(float &r, float &g, float &b)
-{
-    r = (float)rand() / RAND_MAX;
-    g = (float)rand() / RAND_MAX;
-    b = (float)rand() / RAND_MAX;
-}
-
-// Snap camera back to centre of prism
-void reset()
-{
-    cameraTarget = c;
-}
-
-// Process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-// ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+// Render thread: draws the latest snapshot published by the simulation thread and swaps
+// -------------------------------------------------------------------------------------
+void renderLoop(GLFWwindow *window, const Scene *scene, PrismBVH *bvh, RenderOptions options)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-
-    const float cameraSpeed = 0.05f;
+    glfwMakeContextCurrent(window);
 
-    // Part B - 1
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+    PrismRenderer *renderer = new PrismRenderer(*scene, options.meshCache);
+    renderer->setOverdrawMeasurement(options.measureOverdraw);
+    renderer->setOcclusionCulling(options.occlusionCulling);
+    StatsOverlay *overlay = new StatsOverlay();
+    LatencyTracker *latency = new LatencyTracker();
+    FramePacer *pacer = new FramePacer(options.pacing);
+    RenderTargetPool *targets = new RenderTargetPool();
+    DynamicResolution *resolution = options.gpuBudgetMs > 0.0 ? new DynamicResolution(options.gpuBudgetMs, *targets) : NULL;
+    glm::mat4 projection = prismProjection((float)SCR_WIDTH / (float)SCR_HEIGHT); // Follows the framebuffer's aspect ratio
+    int viewWidth = SCR_WIDTH, viewHeight = SCR_HEIGHT;                           // The framebuffer's size
+    bool resizeSettling = false;                                                  // Targets wait to be fitted to the window
+    std::chrono::steady_clock::time_point resizeSettleAt;
+    bool haveSnapshot = false;
+    FrameSnapshot shown;                  // What is on screen, for picking
+    unsigned long long pickedVersion = 0; // Scene graph version the picking BVH was last fitted to
+
+    while (!QUIT_REQUESTED.load())
     {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
-
-        cameraPos += cameraSpeed * glm::vec3(0.0f, 1.0f, 0.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
+        bool fresh = frameSnapshots.update();
+        bool redraw = REDRAW_REQUESTED.exchange(false);
+        bool pickRequested = PICK_REQUESTED.exchange(false);
+
+        if (VIEWPORT_CHANGED.exchange(false))
+        {
+            int width = framebufferWidth, height = framebufferHeight;
+            viewWidth = width;
+            viewHeight = height;
+            renderer->setViewport(width, height);
+            overlay->setViewport(width, height);
+
+            // A minimised window has no aspect ratio; the projection stays as it was until it is restored
+            if (width > 0 && height > 0)
+                projection = prismProjection((float)width / (float)height);
+
+            if (resolution)
+            {
+                resolution->setWindowSize(width, height);
+                resizeSettling = !resolution->targetFits();
+                resizeSettleAt = std::chrono::steady_clock::now() + RESIZE_SETTLE_TIME;
+            }
+            redraw = true;
+        }
+
+        if (resizeSettling && std::chrono::steady_clock::now() >= resizeSettleAt)
+        {
+            resolution->fitTarget();
+            resizeSettling = false;
+            redraw = true;
+        }
+
+        haveSnapshot = haveSnapshot || fresh;
+
+        // Nothing new to show or pick: sleep until the simulation publishes or the window needs repainting
+        if (!haveSnapshot || (!fresh && !redraw && !pickRequested))
+        {
+            overlay->markIdle();
+            pacer->markIdle();
+            if (resizeSettling)
+                frameEvent.waitUntil(resizeSettleAt);
+            else
+                frameEvent.wait();
+            continue;
+        }
+
+        if (fresh || redraw)
+        {
+            // Wait for the GPU and the frame's slot, then draw whatever the simulation published last, which may
+            // be newer than what woke us up
+            pacer->beginFrame();
+            frameSnapshots.update();
+            const FrameSnapshot &snapshot = frameSnapshots.readBuffer();
+            bool showStats = STATS_VISIBLE.load();
+            if (showStats)
+                overlay->beginFrame();
+            else
+                overlay->markIdle();
+
+            // With a GPU budget, the scene goes into an offscreen framebuffer at whatever resolution keeps it within
+            // budget, and is then stretched over the window
+            if (resolution)
+            {
+                resolution->beginFrame();
+                renderer->setViewport(resolution->renderWidth(), resolution->renderHeight());
+                overlay->setRenderResolution(resolution->renderWidth(), resolution->renderHeight());
+            }
+
+            // Render
+            // ------
+            renderer->clear();
+            renderer->setSpin(snapshot.spin);
+            if (snapshot.splitScreen)
+            {
+                // Split screen is a 2x2 grid, the free camera top left and the turntable bottom right. Every cell has
+                // the window's aspect ratio, so they all share its projection.
+                int width = resolution ? resolution->renderWidth() : viewWidth;
+                int height = resolution ? resolution->renderHeight() : viewHeight;
+                RenderView views[SPLIT_VIEW_COUNT];
+                for (int v = 0; v < SPLIT_VIEW_COUNT; v++)
+                {
+                    int column = v % 2, row = 1 - v / 2;
+                    views[v].view = snapshot.splitViews[v];
+                    views[v].projection = projection;
+                    views[v].x = column * width / 2;
+                    views[v].y = row * height / 2;
+                    views[v].width = (column + 1) * width / 2 - views[v].x;
+                    views[v].height = (row + 1) * height / 2 - views[v].y;
+                }
+                renderer->drawViews(snapshot.model, views, SPLIT_VIEW_COUNT);
+            }
+            else
+                renderer->draw(snapshot.model, snapshot.view, projection);
+            shown = snapshot;
+
+            if (resolution)
+                resolution->endFrame();
+
+            // The overlay goes over the prisms, from what they just drew
+            if (showStats)
+                overlay->draw(renderer->frameDrawStats());
+
+            // GLFW: Swap buffers; this blocks on vsync without holding up the simulation
+            // --------------------------------------------------------------------------
+            glfwSwapBuffers(window);
+            pacer->endFrame();
+            latency->frameSwapped(shown.inputTime);
+        }
+        latency->poll();
+
+        // Pick with the matrices and prism transforms of the frame on screen, refitting the BVH first if prisms
+        // have moved since it was last used
+        if (pickRequested)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            const SceneGraph &graph = renderer->sceneGraph();
+            bool refitted = graph.version() != pickedVersion;
+            if (refitted)
+            {
+                bvh->refit(graph);
+                pickedVersion = graph.version();
+            }
+
+            // In split screen, the click is picked in the cell it landed in, with that cell's camera
+            float x = pickX, y = pickY;
+            glm::mat4 view = shown.view;
+            if (shown.splitScreen)
+            {
+                int column = x >= 0.5f ? 1 : 0, row = y >= 0.5f ? 1 : 0;
+                view = shown.splitViews[2 * row + column];
+                x = 2.0f * x - column;
+                y = 2.0f * y - row;
+            }
+
+            glm::vec3 origin, direction;
+            PickResult pick;
+            viewportRay(x, y, shown.model, view, projection, origin, direction);
+            bool hit = bvh->pick(origin, direction, pick);
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            if (hit)
+                std::cout << "Picked prism " << pick.prism << ", face " << pick.face << ", colour (" << pick.color.x << ", "
+                          << pick.color.y << ", " << pick.color.z << ") in " << us << " us";
+            else
+                std::cout << "Picked nothing in " << us << " us";
+            std::cout << (refitted ? ", BVH refitted" : "") << std::endl;
+        }
     }
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-    {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
 
-        cameraPos -= cameraSpeed * glm::vec3(0.0f, 1.0f, 0.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
-    }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    const StreamBufferStats &stats = renderer->streamStats();
+    std::cout << "Stream buffer: " << stats.frames << " frames, " << stats.bytesWritten << " bytes, " << stats.fenceWaits
+              << " fence waits (" << stats.fenceWaitMs << " ms)" << std::endl;
+    const StateCacheStats &state = renderer->stateStats();
+    std::cout << "State cache: " << state.binds << " binds, " << state.bindsAvoided << " avoided ("
+              << (stats.frames ? (double)state.bindsAvoided / stats.frames : 0.0) << " per frame)" << std::endl;
+    if (options.measureOverdraw)
     {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
-
-        cameraPos -= cameraSpeed * glm::vec3(1.0f, 0.0f, 0.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
+        // Fragments shaded per frame and per viewport pixel, in each order
+        const OverdrawStats &overdraw = renderer->overdrawStats();
+        const char *orders[2] = {"front to back", "scene order"};
+        double perFrame[2] = {0.0, 0.0};
+
+        for (int order = 0; order < 2; order++)
+        {
+            perFrame[order] = overdraw.frames[order] ? (double)overdraw.fragments[order] / overdraw.frames[order] : 0.0;
+            std::cout << "Overdraw, " << orders[order] << ": " << perFrame[order] << " fragments per frame ("
+                      << (overdraw.pixels ? perFrame[order] / overdraw.pixels : 0.0) << " per pixel) over "
+                      << overdraw.frames[order] << " frames" << std::endl;
+        }
+
+        if (perFrame[1] > 0.0)
+            std::cout << "Front to back saves " << 100.0 * (1.0 - perFrame[0] / perFrame[1]) << "% of the fragments" << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-    {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
 
-        cameraPos += cameraSpeed * glm::vec3(1.0f, 0.0f, 0.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
-    }
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (const OcclusionStats *occlusion = renderer->occlusionStats())
     {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
-
-        cameraPos += cameraSpeed * glm::vec3(0.0f, 0.0f, 1.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
+        const CullingTimeStats &times = renderer->cullingTimeStats();
+        double culledMs = times.frames[0] ? times.gpuMs[0] / times.frames[0] : 0.0;
+        double referenceMs = times.frames[1] ? times.gpuMs[1] / times.frames[1] : 0.0;
+
+        std::cout << "Occlusion culling: " << occlusion->instancesCulled << " of " << occlusion->instancesTested << " instances culled ("
+                  << (occlusion->instancesTested ? 100.0 * occlusion->instancesCulled / occlusion->instancesTested : 0.0)
+                  << "%) in " << occlusion->sampledFrames << " sampled of " << occlusion->frames << " culled frames" << std::endl;
+        std::cout << "GPU frame time: " << culledMs << " ms culled, " << referenceMs << " ms without culling";
+        if (referenceMs > 0.0)
+            std::cout << " (" << 100.0 * (1.0 - culledMs / referenceMs) << "% faster)";
+        std::cout << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-    {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
 
-        cameraPos -= cameraSpeed * glm::vec3(0.0f, 0.0f, 1.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
-    }
+    const PacingStats &pacingStats = pacer->stats();
+    std::cout << "Frame pacing: " << pacingStats.frames << " frames, " << pacingStats.fenceWaits << " waited for the GPU ("
+              << pacingStats.fenceWaitMs << " ms), " << pacingStats.sleepMs << " ms held back by the cap ("
+              << pacingStats.spinMs << " ms spinning)" << std::endl;
 
-    // Part B - 2
-    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS)
+    if (resolution)
     {
-        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
+        const DynamicResolutionStats &scaling = resolution->stats();
+        std::cout << "Dynamic resolution: " << scaling.changes << " scale changes, average scale "
+                  << (scaling.frames ? scaling.scaleSum / scaling.frames : 1.0) << ", lowest " << scaling.minScale << std::endl;
 
-        model = glm::translate(model, 0.05f * currentRight);
-        c += 0.05f * currentRight;
-        PREVIOUS_WAS_TRANSLATE = true;
+        const RenderTargetStats &pooled = targets->stats();
+        std::cout << "Render targets: " << pooled.allocations << " allocated for " << pooled.acquired << " uses, "
+                  << pooled.deleted << " deleted, " << pooled.bytes << " bytes held" << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
-    {
-        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
 
-        model = glm::translate(model, -0.05f * currentRight);
-        c -= 0.05f * currentRight;
-        PREVIOUS_WAS_TRANSLATE = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
-    {
-        model = glm::translate(model, 0.05f * (cameraTarget - cameraPos));
-        c += 0.05f * (cameraTarget - cameraPos);
-        PREVIOUS_WAS_TRANSLATE = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
+    latency->poll(true);
+    if (latency->gpuStats().count > 0)
     {
-        model = glm::translate(model, -0.05f * (cameraTarget - cameraPos));
-        c -= 0.05f * (cameraTarget - cameraPos);
-        PREVIOUS_WAS_TRANSLATE = true;
+        printLatencyStats("Input latency, key to swap", latency->swapStats());
+        printLatencyStats("Input latency, key to frame done on the GPU", latency->gpuStats());
     }
-    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS)
-    {
-        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
-        glm::vec3 currentUp = glm::normalize(glm::cross(currentRight, cameraTarget - cameraPos));
-
-        model = glm::translate(model, 0.05f * currentUp);
-        c += 0.05f * currentUp;
-        PREVIOUS_WAS_TRANSLATE = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-    {
-        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
-        glm::vec3 currentUp = glm::normalize(glm::cross(currentRight, cameraTarget - cameraPos));
 
-        model = glm::translate(model, -0.05f * currentUp);
-        c -= 0.05f * currentUp;
-        PREVIOUS_WAS_TRANSLATE = true;
-    }
+    MeshArenaStats arenas = renderer->meshes().arenaStats();
+    std::cout << "Meshes: " << renderer->meshes().meshCount() << " on the GPU for " << renderer->objectCount() << " objects, in "
+              << arenas.arenas << " arenas (" << arenas.gpuBytes << " bytes)" << std::endl;
+    std::cout << "Arena vertices: " << arenas.vertices.used << "/" << arenas.vertices.capacity << " used, "
+              << arenas.vertices.freeBlocks << " free blocks, " << 100.0 * arenaFragmentation(arenas.vertices)
+              << "% fragmented" << std::endl;
+    std::cout << "Arena indices: " << arenas.indices.used << "/" << arenas.indices.capacity << " used, "
+              << arenas.indices.freeBlocks << " free blocks, " << 100.0 * arenaFragmentation(arenas.indices)
+              << "% fragmented" << std::endl;
+    delete resolution;
+    delete targets;
+    delete pacer;
+    delete latency;
+    delete overlay;
+    delete renderer;
+
+    glfwMakeContextCurrent(NULL);
+}
 
-    // Part B - 3
-    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+// Software path: render the starting view on the CPU and write it to a PPM file, without touching GLFW or GL
+// ------------------------------------------------------------------------------------------------------------
+int renderSoftware(const MeshView &mesh, const char *path)
+{
+    FrameSnapshot snapshot;
+    simulateTick();
+    captureSnapshot(snapshot);
+
+    SoftwareRasterizer rasterizer(SCR_WIDTH, SCR_HEIGHT, *jobSystem);
+    rasterizer.clear(glm::vec3(0.2f, 0.3f, 0.3f));
+    rasterizer.draw(mesh.vertices, mesh.indices, mesh.indexCount,
+                    prismProjection((float)SCR_WIDTH / (float)SCR_HEIGHT) * snapshot.view * snapshot.model);
+
+    Image image;
+    rasterizer.readPixels(image);
+    if (!writePPM(path, image))
     {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
-
-        cameraPos = glm::vec3(1.0f, 2.0f, 3.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
+        std::cout << "Failed to write " << path << std::endl;
+        return -1;
     }
-    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
-    {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
 
-        cameraPos = glm::vec3(3.0f, 2.0f, 1.0f);
-        PREVIOUS_WAS_TRANSLATE = false;
-    }
+    return 0;
 }
 
-// Part B - 4 and 5
+// GLFW: Key events are forwarded to the simulation thread, except for Escape which closes the window right away and
+// F3 which shows or hides the statistics overlay
+// --------------------------------------------------------------------------------------------------------------------
 void key_was_pressed(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-    if (key == GLFW_KEY_R && action == GLFW_PRESS)
-    {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
-
-        OBJECT_SET_TO_ROTATE = !OBJECT_SET_TO_ROTATE;
-        PREVIOUS_WAS_TRANSLATE = false;
-    }
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
 
-    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
     {
-        if (PREVIOUS_WAS_TRANSLATE)
-            reset();
-
-        CAMERA_SET_TO_REVOLVE = !CAMERA_SET_TO_REVOLVE;
-        PREVIOUS_WAS_TRANSLATE = false;
+        STATS_VISIBLE = !STATS_VISIBLE.load();
+        REDRAW_REQUESTED = true;
+        frameEvent.notify();
     }
+
+    recordKeyEvent(key, action);
 }
 
 // GLFW: Whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
+    VIEWPORT_CHANGED = true;
+    frameEvent.notify();
+}
+
+// GLFW: The window contents were damaged (uncovered, restored, ...) and need to be drawn again
+// --------------------------------------------------------------------------------------------
+void window_refresh_callback(GLFWwindow *window)
+{
+    REDRAW_REQUESTED = true;
+    frameEvent.notify();
+}
+
+// GLFW: A left click asks the render thread to pick what is under the cursor
+// --------------------------------------------------------------------------
+void mouse_button_pressed(GLFWwindow *window, int button, int action, int mods)
+{
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS)
+        return;
+
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0)
+        return;
+
+    pickX = (float)(x / width);
+    pickY = (float)(y / height);
+    PICK_REQUESTED = true;
+    frameEvent.notify();
 }
@@ -0,0 +1,61 @@
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : mapping(NULL), length(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    close();
+
+    int descriptor = ::open(path, O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        ::close(descriptor);
+        return false;
+    }
+
+    if (status.st_size == 0)
+    {
+        ::close(descriptor);
+        return true;
+    }
+
+    length = (size_t)status.st_size;
+    mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+
+    if (mapping == MAP_FAILED)
+    {
+        mapping = NULL;
+        length = 0;
+        return false;
+    }
+
+    // Every user reads the file front to back straight away
+    madvise(mapping, length, MADV_SEQUENTIAL);
+    madvise(mapping, length, MADV_WILLNEED);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapping)
+        munmap(mapping, length);
+
+    mapping = NULL;
+    length = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file, read ahead sequentially. An empty file opens with no data.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char *path);
+    void close();
+
+    const unsigned char *data() const
+    {
+        return (const unsigned char *)mapping;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    void *mapping;
+    size_t length;
+};
+
+#endif
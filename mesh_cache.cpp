@@ -0,0 +1,153 @@
+#include "mesh_cache.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Blocks start on cache line boundaries, which also satisfies any alignment the GL driver could want to copy from
+const uint64_t MESH_BLOCK_ALIGNMENT = 64;
+
+static uint64_t alignBlock(uint64_t offset)
+{
+    return (offset + MESH_BLOCK_ALIGNMENT - 1) & ~(MESH_BLOCK_ALIGNMENT - 1);
+}
+
+// Block offsets and file size for a shape with the given counts
+static void layoutMeshFile(MeshFileHeader &header)
+{
+    header.vertexOffset = alignBlock(sizeof(MeshFileHeader));
+    header.indexOffset = alignBlock(header.vertexOffset + (uint64_t)header.vertexCount * sizeof(PrismShapeVertex));
+    header.fileSize = header.indexOffset + (uint64_t)header.indexCount * sizeof(uint32_t);
+}
+
+std::string meshCachePath(const char *directory, int n)
+{
+    char name[96];
+    snprintf(name, sizeof(name), "/prism-n%d-f%u.mesh", n, MESH_FORMAT_POSITION_FACE);
+    return std::string(directory) + name;
+}
+
+static bool writeBlock(FILE *file, uint64_t offset, const void *data, size_t size)
+{
+    static const char padding[MESH_BLOCK_ALIGNMENT] = {0};
+    long position = ftell(file);
+
+    if (position < 0 || (uint64_t)position > offset)
+        return false;
+    if (offset > (uint64_t)position && fwrite(padding, 1, offset - position, file) != offset - position)
+        return false;
+
+    return fwrite(data, 1, size, file) == size;
+}
+
+bool writeShapeFile(const std::string &path, int n, const ShapeView &shape)
+{
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.format = MESH_FORMAT_POSITION_FACE;
+    header.n = n;
+    header.vertexCount = shape.vertexCount;
+    header.indexCount = shape.indexCount;
+    layoutMeshFile(header);
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+    std::string temporary = path + suffix;
+
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool written = writeBlock(file, 0, &header, sizeof(header)) &&
+                   writeBlock(file, header.vertexOffset, shape.vertices, (size_t)header.vertexCount * sizeof(PrismShapeVertex)) &&
+                   writeBlock(file, header.indexOffset, shape.indices, (size_t)header.indexCount * sizeof(uint32_t));
+
+    if (fclose(file) != 0 || !written || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+MappedMesh::MappedMesh()
+{
+    memset(&shapeMesh, 0, sizeof(shapeMesh));
+}
+
+void MappedMesh::close()
+{
+    file.close();
+    memset(&shapeMesh, 0, sizeof(shapeMesh));
+}
+
+bool MappedMesh::open(const std::string &path, int n)
+{
+    close();
+
+    if (!file.open(path.c_str()) || file.size() < sizeof(MeshFileHeader))
+    {
+        close();
+        return false;
+    }
+
+    // The key, then the counts a prism of this n must have, then the layout those counts imply
+    const MeshFileHeader &header = *(const MeshFileHeader *)file.data();
+    MeshFileHeader expected = header;
+    expected.vertexCount = prismVertexCount(n);
+    expected.indexCount = prismIndexCount(n);
+    layoutMeshFile(expected);
+
+    if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION || header.format != MESH_FORMAT_POSITION_FACE ||
+        header.n != (uint32_t)n || memcmp(&header, &expected, sizeof(header)) != 0 || header.fileSize != file.size())
+    {
+        close();
+        return false;
+    }
+
+    const unsigned char *base = file.data();
+    shapeMesh.vertices = (const PrismShapeVertex *)(base + header.vertexOffset);
+    shapeMesh.vertexCount = header.vertexCount;
+    shapeMesh.indices = (const uint32_t *)(base + header.indexOffset);
+    shapeMesh.indexCount = header.indexCount;
+    return true;
+}
+
+MeshView cachedPrism(const char *directory, int n, uint32_t seed, glm::vec3 centre, PrismMesh &generated, MappedMesh &mapped,
+                     JobSystem &jobs)
+{
+    if (directory == NULL || centre != glm::vec3(0.0f))
+    {
+        generatePrism(n, centre, seed, generated, jobs);
+        return meshView(generated);
+    }
+
+    // Colours are a pure function of the seed and the face, so only the shape is cached, and it is coloured here
+    PrismShape shape;
+    ShapeView view = cachedPrismShape(directory, n, shape, mapped, jobs);
+    colorPrismShape(n, view, seed, generated, jobs);
+    return meshView(generated);
+}
+
+ShapeView cachedPrismShape(const char *directory, int n, PrismShape &generated, MappedMesh &mapped, JobSystem &jobs)
+{
+    std::string path;
+
+    if (directory)
+    {
+        path = meshCachePath(directory, n);
+        if (mapped.open(path, n))
+            return mapped.shape();
+    }
+
+    generatePrismShape(n, generated, jobs);
+
+    if (directory && (mkdir(directory, 0755) == 0 || errno == EEXIST))
+        writeShapeFile(path, n, shapeView(generated));
+
+    return shapeView(generated);
+}
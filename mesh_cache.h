@@ -0,0 +1,79 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "mapped_file.h"
+#include "prism.h"
+
+// Binary mesh file
+// ----------------
+// A header followed by the vertex and index blocks of a prism's shape (position and face number), each starting on
+// a 64-byte boundary so that a mapped file can be handed to glBufferData as it is. Shapes do not depend on the seed,
+// so files are keyed by (n, vertex format) alone; they are written the first time a shape is generated, and colours
+// are applied from the seed as a shape is loaded. Anything that does not match the key, version or its own sizes is
+// ignored.
+const uint32_t MESH_FILE_MAGIC = 0x4D535250; // "PRSM"
+const uint32_t MESH_FILE_VERSION = 2;
+const uint32_t MESH_FORMAT_POSITION_FACE = 2; // PrismShapeVertex: float position (3) and uint32 face, uint32 indices
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t n;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t fileSize;
+};
+
+// Where the shape for n is cached inside directory
+std::string meshCachePath(const char *directory, int n);
+
+// Write shape to path through a temporary file, so a reader never sees a half-written file
+bool writeShapeFile(const std::string &path, int n, const ShapeView &shape);
+
+// Read-only mapping of a cached mesh file; the view points straight into the mapping
+class MappedMesh
+{
+public:
+    MappedMesh();
+
+    // Map the file and check it against the expected key; returns false (and maps nothing) if it does not match
+    bool open(const std::string &path, int n);
+
+    const ShapeView &shape() const
+    {
+        return shapeMesh;
+    }
+
+    size_t size() const
+    {
+        return file.size();
+    }
+
+private:
+    MappedMesh(const MappedMesh &);
+    MappedMesh &operator=(const MappedMesh &);
+
+    void close();
+
+    MappedFile file;
+    ShapeView shapeMesh;
+};
+
+// The prism for (n, seed), in generated: its shape is mapped from directory when it is cached there, otherwise
+// generated and written to directory for next time, and then coloured from the seed. Only prisms centred on the
+// origin are cached; directory may be NULL to disable caching. The returned view stays valid as long as generated
+// does.
+MeshView cachedPrism(const char *directory, int n, uint32_t seed, glm::vec3 centre, PrismMesh &generated, MappedMesh &mapped,
+                     JobSystem &jobs);
+
+// The shape for n alone, mapped from directory or generated into generated and written there
+ShapeView cachedPrismShape(const char *directory, int n, PrismShape &generated, MappedMesh &mapped, JobSystem &jobs);
+
+#endif
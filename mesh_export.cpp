@@ -0,0 +1,283 @@
+#include "mesh_export.h"
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Bytes gathered before each fwrite
+const size_t EXPORT_BUFFER_SIZE = 1 << 20;
+
+// Longest single record the writers append at once
+const size_t EXPORT_MAX_RECORD = 256;
+
+// Append-only output buffer that flushes to a file whenever it fills up, remembering if any write failed
+class ExportWriter
+{
+public:
+    explicit ExportWriter(const char *path) : buffer(EXPORT_BUFFER_SIZE), used(0), failed(false)
+    {
+        file = fopen(path, "wb");
+        failed = file == NULL;
+    }
+
+    ~ExportWriter()
+    {
+        close();
+    }
+
+    // Flush and close; returns whether everything was written
+    bool close()
+    {
+        if (file)
+        {
+            flush();
+            failed = fclose(file) != 0 || failed;
+            file = NULL;
+        }
+        return !failed;
+    }
+
+    void write(const void *data, size_t size)
+    {
+        if (used + size > buffer.size())
+            flush();
+
+        // Large blocks skip the buffer
+        if (size > buffer.size())
+        {
+            if (file && fwrite(data, 1, size, file) != size)
+                failed = true;
+            return;
+        }
+
+        memcpy(&buffer[used], data, size);
+        used += size;
+    }
+
+    void text(const char *string)
+    {
+        write(string, strlen(string));
+    }
+
+    // printf straight into the buffer; records are short, so make room for the longest first
+    template <typename... Args>
+    void format(const char *pattern, Args... args)
+    {
+        if (used + EXPORT_MAX_RECORD > buffer.size())
+            flush();
+
+        int length = snprintf(&buffer[used], EXPORT_MAX_RECORD, pattern, args...);
+        if (length > 0)
+            used += (size_t)length < EXPORT_MAX_RECORD ? length : EXPORT_MAX_RECORD - 1;
+    }
+
+    // Decimal digits without going through printf, for the face lines that make up most of an OBJ file
+    void number(unsigned int value)
+    {
+        char digits[10];
+        int count = 0;
+
+        do
+        {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value);
+
+        if (used + count > buffer.size())
+            flush();
+        while (count)
+            buffer[used++] = digits[--count];
+    }
+
+    void character(char c)
+    {
+        if (used == buffer.size())
+            flush();
+        buffer[used++] = c;
+    }
+
+    bool ok() const
+    {
+        return !failed;
+    }
+
+private:
+    ExportWriter(const ExportWriter &);
+    ExportWriter &operator=(const ExportWriter &);
+
+    void flush()
+    {
+        if (file && used && fwrite(buffer.data(), 1, used, file) != used)
+            failed = true;
+        used = 0;
+    }
+
+    FILE *file;
+    std::vector<char> buffer;
+    size_t used;
+    bool failed;
+};
+
+static bool hasExtension(const char *path, const char *extension)
+{
+    size_t length = strlen(path), extensionLength = strlen(extension);
+    if (length < extensionLength)
+        return false;
+
+    for (size_t i = 0; i < extensionLength; i++)
+    {
+        char c = path[length - extensionLength + i];
+        if (c >= 'A' && c <= 'Z')
+            c = c - 'A' + 'a';
+        if (c != extension[i])
+            return false;
+    }
+    return true;
+}
+
+// Wavefront OBJ
+// -------------
+bool exportOBJ(const char *path, int n, const MeshView &mesh)
+{
+    std::string materialPath = path;
+    if (hasExtension(path, ".obj"))
+        materialPath.resize(materialPath.size() - 4);
+    materialPath += ".mtl";
+
+    std::string materialName = materialPath;
+    size_t slash = materialName.find_last_of("/\\");
+    if (slash != std::string::npos)
+        materialName = materialName.substr(slash + 1);
+
+    // One material per face
+    ExportWriter materials(materialPath.c_str());
+    for (int face = 0; face < mesh.faceCount; face++)
+    {
+        const float *color = &mesh.faceColors[3 * face];
+        materials.format("newmtl face%d\nKd %.9g %.9g %.9g\n", face, color[0], color[1], color[2]);
+    }
+    if (!materials.close())
+        return false;
+
+    ExportWriter obj(path);
+    obj.format("# Prism, n = %d\nmtllib ", n);
+    obj.text(materialName.c_str());
+    obj.character('\n');
+
+    // Only the two cap rings carry distinct positions; OBJ indices start at 1
+    for (int vertex = 0; vertex < 2 * n; vertex++)
+    {
+        const float *position = &mesh.vertices[6 * vertex];
+        obj.format("v %.9g %.9g %.9g\n", position[0], position[1], position[2]);
+    }
+
+    int triangleCount = mesh.indexCount / 3;
+    int currentFace = -1;
+    for (int triangle = 0; triangle < triangleCount; triangle++)
+    {
+        int face = prismTriangleFace(n, triangle);
+        if (face != currentFace)
+        {
+            obj.text("usemtl face");
+            obj.number(face);
+            obj.character('\n');
+            currentFace = face;
+        }
+
+        obj.character('f');
+        for (int k = 0; k < 3; k++)
+        {
+            obj.character(' ');
+            obj.number(prismPositionIndex(n, mesh.indices[3 * triangle + k]) + 1);
+        }
+        obj.character('\n');
+    }
+
+    return obj.close();
+}
+
+// Binary glTF
+// -----------
+// A 12-byte header, then a JSON chunk describing the scene and a binary chunk holding the interleaved vertex block
+// followed by the index block. Sizes are all known up front, so the JSON is written first and the binary data
+// streamed after it.
+const uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+bool exportGLB(const char *path, const MeshView &mesh)
+{
+    uint64_t vertexBytes = (uint64_t)mesh.vertexCount * 6 * sizeof(float);
+    uint64_t indexBytes = (uint64_t)mesh.indexCount * sizeof(uint32_t);
+    uint64_t binaryBytes = vertexBytes + indexBytes;
+
+    // Positions need their bounds in the accessor
+    float minimum[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, maximum[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (int vertex = 0; vertex < mesh.vertexCount; vertex++)
+        for (int k = 0; k < 3; k++)
+        {
+            float value = mesh.vertices[6 * vertex + k];
+            minimum[k] = value < minimum[k] ? value : minimum[k];
+            maximum[k] = value > maximum[k] ? value : maximum[k];
+        }
+
+    char json[2048];
+    int jsonLength = snprintf(
+        json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Prism\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+        "\"nodes\":[{\"mesh\":0}],\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"COLOR_0\":1},"
+        "\"indices\":2,\"material\":0}]}],\"extensionsUsed\":[\"KHR_materials_unlit\"],"
+        "\"materials\":[{\"pbrMetallicRoughness\":{\"metallicFactor\":0,\"roughnessFactor\":1},"
+        "\"extensions\":{\"KHR_materials_unlit\":{}}}],\"buffers\":[{\"byteLength\":%llu}],"
+        "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%llu,\"byteStride\":24,\"target\":34962},"
+        "{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":34963}],"
+        "\"accessors\":[{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\","
+        "\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+        "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"},"
+        "{\"bufferView\":1,\"byteOffset\":0,\"componentType\":5125,\"count\":%d,\"type\":\"SCALAR\"}]}",
+        (unsigned long long)binaryBytes, (unsigned long long)vertexBytes, (unsigned long long)vertexBytes,
+        (unsigned long long)indexBytes, mesh.vertexCount, minimum[0], minimum[1], minimum[2], maximum[0], maximum[1],
+        maximum[2], mesh.vertexCount, mesh.indexCount);
+
+    if (jsonLength <= 0 || jsonLength >= (int)sizeof(json))
+        return false;
+
+    // Chunks are padded to 4 bytes: JSON with spaces, binary data with zeros
+    uint32_t jsonChunk = (jsonLength + 3) & ~3u;
+    uint32_t binaryChunk = (uint32_t)((binaryBytes + 3) & ~3ull);
+    uint64_t totalBytes = 12 + 8 + (uint64_t)jsonChunk + 8 + binaryChunk;
+
+    // GLB lengths are 32-bit
+    if (totalBytes > 0xFFFFFFFFull)
+        return false;
+
+    ExportWriter glb(path);
+    uint32_t header[3] = {GLB_MAGIC, 2, (uint32_t)totalBytes};
+    glb.write(header, sizeof(header));
+
+    uint32_t jsonHeader[2] = {jsonChunk, GLB_CHUNK_JSON};
+    glb.write(jsonHeader, sizeof(jsonHeader));
+    glb.write(json, jsonLength);
+    for (uint32_t i = jsonLength; i < jsonChunk; i++)
+        glb.character(' ');
+
+    uint32_t binaryHeader[2] = {binaryChunk, GLB_CHUNK_BIN};
+    glb.write(binaryHeader, sizeof(binaryHeader));
+    glb.write(mesh.vertices, vertexBytes);
+    glb.write(mesh.indices, indexBytes);
+    for (uint64_t i = binaryBytes; i < binaryChunk; i++)
+        glb.character('\0');
+
+    return glb.close();
+}
+
+bool exportMesh(const char *path, int n, const MeshView &mesh)
+{
+    if (hasExtension(path, ".obj"))
+        return exportOBJ(path, n, mesh);
+    if (hasExtension(path, ".glb"))
+        return exportGLB(path, mesh);
+
+    return false;
+}
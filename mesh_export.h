@@ -0,0 +1,20 @@
+#ifndef MESH_EXPORT_H
+#define MESH_EXPORT_H
+
+#include "prism.h"
+
+// Mesh export
+// -----------
+// Both writers stream the mesh through a fixed-size buffer, so memory use does not grow with n.
+
+// Wavefront OBJ plus a material library beside it (the same path with an .mtl extension). Side vertices that
+// repeat a cap ring position are written once, and every face gets its own material with its colour.
+bool exportOBJ(const char *path, int n, const MeshView &mesh);
+
+// Binary glTF 2.0: the vertex and index blocks are copied as they are, with per-vertex colours and an unlit material
+bool exportGLB(const char *path, const MeshView &mesh);
+
+// Pick the writer from the extension of path (.obj or .glb); false for anything else or on a write error
+bool exportMesh(const char *path, int n, const MeshView &mesh);
+
+#endif
@@ -0,0 +1,157 @@
+#include "mesh_registry.h"
+#include "mesh_cache.h"
+#include "prism.h"
+
+// Default arena size: room for several prisms of tens of thousands of sides (16 MB of vertices, 8 MB of indices)
+const size_t ARENA_VERTICES = 1 << 20;
+const size_t ARENA_INDICES = 1 << 21;
+
+MeshRegistry::MeshRegistry(const char *cacheDirectory, JobSystem &jobs) : cacheDirectory(cacheDirectory), jobs(jobs)
+{
+}
+
+MeshRegistry::~MeshRegistry()
+{
+    for (std::map<int, GpuMesh *>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+        delete it->second;
+
+    for (size_t i = 0; i < arenas.size(); i++)
+    {
+        glDeleteVertexArrays(1, &arenas[i]->VAO);
+        glDeleteBuffers(1, &arenas[i]->VBO);
+        glDeleteBuffers(1, &arenas[i]->EBO);
+        delete arenas[i];
+    }
+}
+
+GpuMesh *MeshRegistry::acquire(int n, int lod)
+{
+    int sides = prismLodSides(n, lod);
+
+    std::map<int, GpuMesh *>::iterator it = meshes.find(sides);
+    GpuMesh *mesh = it != meshes.end() ? it->second : upload(sides);
+
+    mesh->references++;
+    return mesh;
+}
+
+void MeshRegistry::release(GpuMesh *mesh)
+{
+    if (--mesh->references > 0)
+        return;
+
+    // The ranges go back to the arena; the arena itself stays for whatever comes next
+    Arena &arena = *arenas[mesh->arena];
+    arena.vertices.free(mesh->baseVertex, mesh->vertexCount);
+    arena.indices.free(mesh->firstIndex, mesh->indexCount);
+
+    meshes.erase(mesh->sides);
+    delete mesh;
+}
+
+MeshArenaStats MeshRegistry::arenaStats() const
+{
+    MeshArenaStats total = {(int)arenas.size(), {0, 0, 0, 0}, {0, 0, 0, 0}, 0};
+
+    for (size_t i = 0; i < arenas.size(); i++)
+    {
+        ArenaStats vertices = arenas[i]->vertices.stats();
+        ArenaStats indices = arenas[i]->indices.stats();
+
+        total.vertices.capacity += vertices.capacity;
+        total.vertices.used += vertices.used;
+        total.vertices.freeBlocks += vertices.freeBlocks;
+        total.vertices.largestFree = vertices.largestFree > total.vertices.largestFree ? vertices.largestFree : total.vertices.largestFree;
+
+        total.indices.capacity += indices.capacity;
+        total.indices.used += indices.used;
+        total.indices.freeBlocks += indices.freeBlocks;
+        total.indices.largestFree = indices.largestFree > total.indices.largestFree ? indices.largestFree : total.indices.largestFree;
+
+        total.gpuBytes += vertices.capacity * sizeof(PrismShapeVertex) + indices.capacity * sizeof(uint32_t);
+    }
+
+    return total;
+}
+
+int MeshRegistry::createArena(size_t vertexCapacity, size_t indexCapacity)
+{
+    Arena *arena = new Arena(vertexCapacity, indexCapacity);
+
+    glGenVertexArrays(1, &arena->VAO);
+    glGenBuffers(1, &arena->VBO);
+    glGenBuffers(1, &arena->EBO);
+
+    glBindVertexArray(arena->VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena->VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * sizeof(PrismShapeVertex), NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * sizeof(uint32_t), NULL, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, sizeof(PrismShapeVertex), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(PrismShapeVertex), (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    arenas.push_back(arena);
+    return (int)arenas.size() - 1;
+}
+
+GpuMesh *MeshRegistry::upload(int sides)
+{
+    PrismShape generated;
+    MappedMesh mapped;
+    ShapeView shape = cachedPrismShape(cacheDirectory, sides, generated, mapped, jobs);
+
+    GpuMesh *mesh = new GpuMesh();
+    mesh->sides = sides;
+    mesh->vertexCount = shape.vertexCount;
+    mesh->indexCount = shape.indexCount;
+    mesh->references = 0;
+
+    // First arena with room for both halves of the mesh
+    size_t baseVertex = 0, firstIndex = 0;
+    mesh->arena = -1;
+    for (size_t i = 0; i < arenas.size() && mesh->arena < 0; i++)
+    {
+        if (!arenas[i]->vertices.allocate(shape.vertexCount, baseVertex))
+            continue;
+        if (!arenas[i]->indices.allocate(shape.indexCount, firstIndex))
+        {
+            arenas[i]->vertices.free(baseVertex, shape.vertexCount);
+            continue;
+        }
+        mesh->arena = (int)i;
+    }
+
+    if (mesh->arena < 0)
+    {
+        size_t vertexCapacity = (size_t)shape.vertexCount > ARENA_VERTICES ? (size_t)shape.vertexCount : ARENA_VERTICES;
+        size_t indexCapacity = (size_t)shape.indexCount > ARENA_INDICES ? (size_t)shape.indexCount : ARENA_INDICES;
+        mesh->arena = createArena(vertexCapacity, indexCapacity);
+        arenas[mesh->arena]->vertices.allocate(shape.vertexCount, baseVertex);
+        arenas[mesh->arena]->indices.allocate(shape.indexCount, firstIndex);
+    }
+
+    Arena &arena = *arenas[mesh->arena];
+    mesh->VAO = arena.VAO;
+    mesh->baseVertex = (GLint)baseVertex;
+    mesh->firstIndex = firstIndex;
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena.VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)baseVertex * sizeof(PrismShapeVertex),
+                    (GLsizeiptr)shape.vertexCount * sizeof(PrismShapeVertex), shape.vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The element buffer binding is VAO state, so go through the copy binding instead of disturbing a VAO
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(uint32_t), (GLsizeiptr)shape.indexCount * sizeof(uint32_t),
+                    shape.indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    meshes[sides] = mesh;
+    return mesh;
+}
@@ -0,0 +1,87 @@
+#ifndef MESH_REGISTRY_H
+#define MESH_REGISTRY_H
+
+#include <glad/glad.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include "gpu_arena.h"
+#include "job_system.h"
+
+// One prism shape on the GPU: a range of an arena's vertices and a range of its indices. VAO is the arena's, so
+// meshes from one arena are drawn without rebinding, with glDrawElements*BaseVertex(..., firstIndex, baseVertex).
+struct GpuMesh
+{
+    int sides;
+    int arena;
+    unsigned int VAO;
+    GLint baseVertex;
+    size_t firstIndex;
+    int vertexCount;
+    int indexCount;
+    int references;
+};
+
+// Usage of all the arenas together
+struct MeshArenaStats
+{
+    int arenas;
+    ArenaStats vertices;
+    ArenaStats indices;
+    size_t gpuBytes; // Buffer storage allocated, used or not
+};
+
+// Shared prism geometry
+// ---------------------
+// Objects only keep a transform and a colour seed; the geometry itself is uploaded once per distinct shape and
+// shared by every object with the same number of sides, whatever their colours. Meshes are requested by n and
+// level of detail and reference counted: levels that come out at the same number of sides get the same mesh, and
+// a mesh is freed when its last user releases it. Shapes come from the mesh cache when a directory is given.
+//
+// Meshes do not get buffer objects of their own: they are packed into a few large vertex and index arenas, each
+// pair with one VAO (PrismShapeVertex position at attribute 0, face at attribute 1). A new arena is only created
+// when no existing one has room; a mesh bigger than the default arena size gets an arena sized to fit.
+// Must be created and used on the thread that owns the context.
+class MeshRegistry
+{
+public:
+    MeshRegistry(const char *cacheDirectory, JobSystem &jobs);
+    ~MeshRegistry();
+
+    GpuMesh *acquire(int n, int lod);
+    void release(GpuMesh *mesh);
+
+    // Distinct meshes currently on the GPU
+    size_t meshCount() const
+    {
+        return meshes.size();
+    }
+
+    MeshArenaStats arenaStats() const;
+
+private:
+    MeshRegistry(const MeshRegistry &);
+    MeshRegistry &operator=(const MeshRegistry &);
+
+    // A vertex buffer and an index buffer sub-allocated together, counted in vertices and indices
+    struct Arena
+    {
+        unsigned int VAO, VBO, EBO;
+        ArenaAllocator vertices;
+        ArenaAllocator indices;
+
+        Arena(size_t vertexCapacity, size_t indexCapacity) : vertices(vertexCapacity), indices(indexCapacity)
+        {
+        }
+    };
+
+    GpuMesh *upload(int sides);
+    int createArena(size_t vertexCapacity, size_t indexCapacity);
+
+    const char *cacheDirectory;
+    JobSystem &jobs;
+    std::map<int, GpuMesh *> meshes; // By number of sides
+    std::vector<Arena *> arenas;
+};
+
+#endif
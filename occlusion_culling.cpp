@@ -0,0 +1,349 @@
+#include "occlusion_culling.h"
+#include <glm/gtc/type_ptr.hpp>
+#include "render_targets.h"
+#include "renderer.h"
+
+// Instance attribute locations of the culling pass
+const GLuint CULL_ROWS_LOCATION = 0;
+const GLuint CULL_ROW_COUNT = 3;
+
+// Test one instance: its bounding box (the prism's, [-0.5, 0.5] on every axis, through the instance transform)
+// against the pyramid, and write through transform feedback whether it was culled. Anything reaching behind the
+// eye counts as visible.
+const char *cullVertexShaderSource = "#version 330 core\n"
+                                     "layout (location = 0) in vec4 aRow0;\n"
+                                     "layout (location = 1) in vec4 aRow1;\n"
+                                     "layout (location = 2) in vec4 aRow2;\n"
+                                     "uniform mat4 viewProjection;\n"
+                                     "uniform sampler2D hiZ;\n"
+                                     "uniform ivec2 hiZSize;\n"
+                                     "uniform int hiZLevels;\n"
+                                     "flat out uint outCulled;\n"
+                                     "bool visible()\n"
+                                     "{\n"
+                                     "   vec2 low = vec2(1.0);\n"
+                                     "   vec2 high = vec2(-1.0);\n"
+                                     "   float nearest = 1.0;\n"
+                                     "   for (int i = 0; i < 8; i++)\n"
+                                     "   {\n"
+                                     "      vec4 p = vec4((i & 1) != 0 ? 0.5 : -0.5, (i & 2) != 0 ? 0.5 : -0.5, (i & 4) != 0 ? 0.5 : -0.5, 1.0);\n"
+                                     "      vec4 clip = viewProjection * vec4(dot(aRow0, p), dot(aRow1, p), dot(aRow2, p), 1.0);\n"
+                                     "      if (clip.w <= 0.0)\n"
+                                     "         return true;\n"
+                                     "      vec3 ndc = clip.xyz / clip.w;\n"
+                                     "      low = min(low, ndc.xy);\n"
+                                     "      high = max(high, ndc.xy);\n"
+                                     "      nearest = min(nearest, ndc.z);\n"
+                                     "   }\n"
+                                     "   if (any(greaterThan(low, vec2(1.0))) || any(lessThan(high, vec2(-1.0))) || nearest > 1.0)\n"
+                                     "      return false;\n"
+                                     "   vec2 size = vec2(hiZSize);\n"
+                                     "   vec2 minPixel = clamp(low * 0.5 + 0.5, 0.0, 1.0) * size;\n"
+                                     "   vec2 maxPixel = clamp(high * 0.5 + 0.5, 0.0, 1.0) * size;\n"
+                                     "   vec2 extent = maxPixel - minPixel;\n"
+                                     "   int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);\n"
+                                     "   ivec2 last = max(hiZSize >> level, ivec2(1)) - 1;\n"
+                                     "   ivec2 a = min(ivec2(minPixel) >> level, last);\n"
+                                     "   ivec2 b = min(ivec2(maxPixel) >> level, last);\n"
+                                     "   float farthest = max(max(texelFetch(hiZ, a, level).r, texelFetch(hiZ, ivec2(b.x, a.y), level).r),\n"
+                                     "                        max(texelFetch(hiZ, ivec2(a.x, b.y), level).r, texelFetch(hiZ, b, level).r));\n"
+                                     "   return nearest * 0.5 + 0.5 <= farthest;\n"
+                                     "}\n"
+                                     "void main()\n"
+                                     "{\n"
+                                     "   outCulled = visible() ? 0u : 1u;\n"
+                                     "}\0";
+
+const char *const cullFeedbackVaryings[] = {"outCulled"};
+
+// Full-screen triangle that writes, for every texel of one pyramid level, the farthest depth of the 2x2 texels
+// below it (3 wide or high at the last texel of an odd-sized level), read from the texture's base level. Only the
+// bottom-left sourceSize texels of that level are in use.
+const char *reduceVertexShaderSource = "#version 330 core\n"
+                                       "void main()\n"
+                                       "{\n"
+                                       "   vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+                                       "   gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+                                       "}\0";
+
+const char *reduceFragmentShaderSource = "#version 330 core\n"
+                                         "uniform sampler2D depthLevel;\n"
+                                         "uniform ivec2 sourceSize;\n"
+                                         "float fetch(ivec2 texel, ivec2 size)\n"
+                                         "{\n"
+                                         "   return texelFetch(depthLevel, min(texel, size - 1), 0).r;\n"
+                                         "}\n"
+                                         "void main()\n"
+                                         "{\n"
+                                         "   ivec2 size = sourceSize;\n"
+                                         "   ivec2 c = ivec2(gl_FragCoord.xy) * 2;\n"
+                                         "   float depth = max(max(fetch(c, size), fetch(c + ivec2(1, 0), size)),\n"
+                                         "                     max(fetch(c + ivec2(0, 1), size), fetch(c + ivec2(1, 1), size)));\n"
+                                         "   bool extraX = (size.x & 1) != 0 && c.x == size.x - 3;\n"
+                                         "   bool extraY = (size.y & 1) != 0 && c.y == size.y - 3;\n"
+                                         "   if (extraX)\n"
+                                         "      depth = max(depth, max(fetch(c + ivec2(2, 0), size), fetch(c + ivec2(2, 1), size)));\n"
+                                         "   if (extraY)\n"
+                                         "      depth = max(depth, max(fetch(c + ivec2(0, 2), size), fetch(c + ivec2(1, 2), size)));\n"
+                                         "   if (extraX && extraY)\n"
+                                         "      depth = max(depth, fetch(c + ivec2(2, 2), size));\n"
+                                         "   gl_FragDepth = depth;\n"
+                                         "}\n\0";
+
+OcclusionCuller::OcclusionCuller()
+{
+    cullProgram = buildShaderProgram(cullVertexShaderSource, NULL, NULL, cullFeedbackVaryings, 1);
+    reduceProgram = buildShaderProgram(reduceVertexShaderSource, reduceFragmentShaderSource);
+
+    glUseProgram(cullProgram);
+    glUniform1i(glGetUniformLocation(cullProgram, "hiZ"), 0);
+    glUseProgram(reduceProgram);
+    glUniform1i(glGetUniformLocation(reduceProgram, "depthLevel"), 0);
+    sourceSizeLocation = glGetUniformLocation(reduceProgram, "sourceSize");
+    glUseProgram(0);
+
+    // Instances are read one per point; the attribute pointers are set for every draw's range
+    glGenVertexArrays(1, &cullVAO);
+    glBindVertexArray(cullVAO);
+    for (GLuint location = CULL_ROWS_LOCATION; location < CULL_ROWS_LOCATION + CULL_ROW_COUNT; location++)
+        glEnableVertexAttribArray(location);
+    glGenVertexArrays(1, &emptyVAO);
+    glBindVertexArray(0);
+
+    glGenTextures(1, &pyramid);
+    glGenFramebuffers(1, &framebuffer);
+    width = height = levels = 0;
+    allocatedWidth = allocatedHeight = 0;
+
+    glGenBuffers(1, &output);
+    outputCapacity = outputUsed = 0;
+
+    glGenBuffers(1, &sampleBuffer);
+    sampleCapacity = sampleCount = 0;
+    sampleFence = NULL;
+    counters.frames = counters.sampledFrames = counters.instancesTested = counters.instancesCulled = 0;
+    counters.glCalls = 0;
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    if (sampleFence)
+        glDeleteSync(sampleFence);
+    glDeleteBuffers(1, &sampleBuffer);
+    glDeleteBuffers(1, &output);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &pyramid);
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteVertexArrays(1, &cullVAO);
+    glDeleteProgram(reduceProgram);
+    glDeleteProgram(cullProgram);
+}
+
+void OcclusionCuller::beginFrame(size_t instanceCount)
+{
+    if (instanceCount > outputCapacity)
+    {
+        outputCapacity = instanceCount;
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, output);
+        glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, (GLsizeiptr)(outputCapacity * sizeof(GLuint)), NULL, GL_STREAM_COPY);
+        glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+        counters.glCalls += 3;
+    }
+
+    outputUsed = 0;
+
+    glUseProgram(cullProgram);
+    glUniformMatrix4fv(glGetUniformLocation(cullProgram, "viewProjection"), 1, GL_FALSE, glm::value_ptr(pyramidViewProjection));
+    glUniform2i(glGetUniformLocation(cullProgram, "hiZSize"), width, height);
+    glUniform1i(glGetUniformLocation(cullProgram, "hiZLevels"), levels);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    glBindVertexArray(cullVAO);
+    glEnable(GL_RASTERIZER_DISCARD);
+    counters.glCalls += 11;
+}
+
+GLintptr OcclusionCuller::cull(GLuint buffer, GLintptr offset, GLsizei count)
+{
+    GLintptr outputOffset = (GLintptr)(outputUsed * sizeof(GLuint));
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (GLuint row = 0; row < CULL_ROW_COUNT; row++)
+        glVertexAttribPointer(CULL_ROWS_LOCATION + row, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(offset + row * sizeof(glm::vec4)));
+
+    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, output, outputOffset, (GLsizeiptr)count * sizeof(GLuint));
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, count);
+    glEndTransformFeedback();
+    counters.glCalls += 5 + CULL_ROW_COUNT;
+
+    outputUsed += count;
+    return outputOffset;
+}
+
+void OcclusionCuller::endFrame()
+{
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    counters.glCalls += 4;
+    counters.frames++;
+
+    // Only one frame's flags are in flight for the stats at a time, and they are only counted once the GPU is done
+    // with them, so the stats never make the CPU wait
+    if (sampleFence)
+        countSample();
+    if (sampleFence || outputUsed == 0)
+        return;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, output);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, sampleBuffer);
+    if (outputUsed > sampleCapacity)
+    {
+        sampleCapacity = outputCapacity;
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(sampleCapacity * sizeof(GLuint)), NULL, GL_STREAM_READ);
+        counters.glCalls++;
+    }
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)(outputUsed * sizeof(GLuint)));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    sampleCount = outputUsed;
+    sampleFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    counters.glCalls += 6;
+}
+
+void OcclusionCuller::countSample()
+{
+    counters.glCalls++;
+    if (glClientWaitSync(sampleFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        return;
+
+    glDeleteSync(sampleFence);
+    sampleFence = NULL;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, sampleBuffer);
+    const GLuint *flags = (const GLuint *)glMapBufferRange(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)(sampleCount * sizeof(GLuint)), GL_MAP_READ_BIT);
+    if (flags)
+    {
+        for (size_t i = 0; i < sampleCount; i++)
+            counters.instancesCulled += flags[i] != 0;
+        counters.instancesTested += sampleCount;
+        counters.sampledFrames++;
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        counters.glCalls++;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    counters.glCalls += 4;
+}
+
+// The texture is allocated at the viewport's size rounded up to render target buckets, and the pyramid is built in
+// its bottom-left corner, so resizing within a bucket or changing the render scale allocates nothing
+void OcclusionCuller::resizePyramid(int newWidth, int newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+
+    levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        levels++;
+
+    if (renderTargetBucket(width) == allocatedWidth && renderTargetBucket(height) == allocatedHeight)
+        return;
+
+    allocatedWidth = renderTargetBucket(width);
+    allocatedHeight = renderTargetBucket(height);
+    int allocatedLevels = 1;
+    while ((allocatedWidth >> allocatedLevels) > 0 || (allocatedHeight >> allocatedLevels) > 0)
+        allocatedLevels++;
+
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    for (int level = 0; level < allocatedLevels; level++)
+    {
+        int levelWidth = allocatedWidth >> level > 0 ? allocatedWidth >> level : 1;
+        int levelHeight = allocatedHeight >> level > 0 ? allocatedHeight >> level : 1;
+        glTexImage2D(GL_TEXTURE_2D, level, GL_DEPTH_COMPONENT24, levelWidth, levelHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    counters.glCalls += 10 + allocatedLevels;
+}
+
+void OcclusionCuller::invalidate()
+{
+    width = height = levels = 0;
+}
+
+void OcclusionCuller::buildPyramid(int viewportWidth, int viewportHeight, const glm::mat4 &viewProjection)
+{
+    if (viewportWidth <= 0 || viewportHeight <= 0)
+    {
+        levels = 0;
+        return;
+    }
+
+    // The frame may have been drawn into an offscreen framebuffer; the depth comes from there and it is bound again
+    // afterwards
+    GLint drawnTo = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &drawnTo);
+    counters.glCalls++;
+
+    if (viewportWidth != width || viewportHeight != height)
+    {
+        resizePyramid(viewportWidth, viewportHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)drawnTo);
+        counters.glCalls++;
+    }
+
+    // Level 0 is a straight copy of the depth buffer
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    counters.glCalls += 5;
+
+    // Every further level is drawn from the one before it. Only that level is visible to the shader while the
+    // next one is attached, so the texture is never read and written at the same level.
+    glUseProgram(reduceProgram);
+    glBindVertexArray(emptyVAO);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glDepthFunc(GL_ALWAYS);
+    counters.glCalls += 4;
+
+    for (int level = 1; level < levels; level++)
+    {
+        int levelWidth = width >> level > 0 ? width >> level : 1;
+        int levelHeight = height >> level > 0 ? height >> level : 1;
+
+        glUniform2i(sourceSizeLocation, width >> (level - 1) > 0 ? width >> (level - 1) : 1,
+                    height >> (level - 1) > 0 ? height >> (level - 1) : 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, pyramid, level);
+        glViewport(0, 0, levelWidth, levelHeight);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        counters.glCalls += 6;
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glDepthFunc(GL_LESS);
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)drawnTo);
+    glBindVertexArray(0);
+    glViewport(0, 0, width, height);
+    counters.glCalls += 6;
+
+    pyramidViewProjection = viewProjection;
+}
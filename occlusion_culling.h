@@ -0,0 +1,92 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct OcclusionStats
+{
+    unsigned long long frames;          // Frames culled against the pyramid
+    unsigned long long sampledFrames;   // Of those, the frames whose results were read back and counted below
+    unsigned long long instancesTested;
+    unsigned long long instancesCulled;
+    unsigned long long glCalls;         // Made culling, counting the samples and building the pyramid
+};
+
+// Hierarchical-Z occlusion culling
+// --------------------------------
+// After a frame is drawn, its depth buffer is copied into a texture and reduced into a mip pyramid where every
+// texel holds the farthest depth of the texels below it. The next frame tests instances against that pyramid on
+// the GPU before drawing them: a vertex shader projects each instance's bounding box with the matrices the pyramid
+// was drawn with, reads the one pyramid level where the box covers at most 2x2 texels, and writes one flag per
+// instance, set if it is hidden or outside the view, to an output buffer through transform feedback. The draws keep
+// all their instances and read the flags as an instance attribute, so nothing is read back before drawing and the
+// CPU never waits on the culling. As the pyramid is a frame old, something that comes into view from behind an
+// occluder can show up a frame late.
+// Must be created and used on the thread that owns the context.
+class OcclusionCuller
+{
+public:
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    // Whether a pyramid has been built that culling can test against
+    bool ready() const
+    {
+        return levels > 0;
+    }
+
+    // Start a frame's culling of up to instanceCount instances: binds the culling program and output buffer state
+    // and turns rasterization off. Must be followed by cull() for every draw, then endFrame().
+    void beginFrame(size_t instanceCount);
+
+    // Test count instances (InstanceData) at offset in buffer, writing a GLuint flag for each of them (non-zero if
+    // culled) at the next free place in the output buffer; returns where the flags start there
+    GLintptr cull(GLuint buffer, GLintptr offset, GLsizei count);
+
+    // Turn rasterization back on. Whenever no earlier frame's flags are still waiting to be counted, this frame's
+    // are copied aside to be counted for stats() once the GPU is done with them.
+    void endFrame();
+
+    GLuint outputBuffer() const
+    {
+        return output;
+    }
+
+    // Drop the pyramid, as the frames drawn since do not match it; culling is off until buildPyramid() is called again
+    void invalidate();
+
+    // Copy the viewport's depth from the bound framebuffer and build the pyramid from it, for culling the next frame;
+    // viewProjection (including the model matrix) is what the frame was drawn with
+    void buildPyramid(int width, int height, const glm::mat4 &viewProjection);
+
+    const OcclusionStats &stats() const
+    {
+        return counters;
+    }
+
+private:
+    void resizePyramid(int width, int height);
+
+    unsigned int cullProgram, reduceProgram;
+    GLint sourceSizeLocation;
+    unsigned int cullVAO, emptyVAO;
+    GLuint pyramid, framebuffer;
+    int width, height, levels;           // In use, from the last viewport
+    int allocatedWidth, allocatedHeight; // Of the texture's base level
+    glm::mat4 pyramidViewProjection;
+
+    void countSample();
+
+    GLuint output;
+    size_t outputCapacity; // Instances
+    size_t outputUsed;
+
+    GLuint sampleBuffer;   // A copy of one frame's flags, counted once sampleFence has signalled
+    size_t sampleCapacity; // Instances
+    size_t sampleCount;
+    GLsync sampleFence;
+    OcclusionStats counters;
+};
+
+#endif
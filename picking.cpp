@@ -0,0 +1,505 @@
+#include "picking.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// Leaves hold at most this many prisms, and splits are chosen among this many bins per axis
+const int BVH_MAX_LEAF_PRISMS = 4;
+const int BVH_BINS = 16;
+
+// Cost of visiting a node relative to intersecting one prism, for the surface area heuristic
+const float BVH_TRAVERSAL_COST = 1.0f;
+
+// Prisms with more sides than this find their entry side from its angle instead of trying every side
+const int PICK_SCAN_SIDES = 16;
+
+void viewportRay(float x, float y, const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection,
+                 glm::vec3 &origin, glm::vec3 &direction)
+{
+    glm::mat4 inverse = glm::inverse(projection * view * model);
+    glm::vec2 ndc(2.0f * x - 1.0f, 1.0f - 2.0f * y);
+
+    glm::vec4 nearPoint = inverse * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+    origin = glm::vec3(nearPoint) / nearPoint.w;
+    direction = glm::vec3(farPoint) / farPoint.w - origin;
+}
+
+static float surfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+PrismBVH::PrismBVH() : maxDepth(0)
+{
+}
+
+// World box of a prism's [-0.5, 0.5] box
+static void prismBounds(const glm::mat4 &transform, glm::vec3 &min, glm::vec3 &max)
+{
+    glm::vec3 centre(transform[3]);
+    glm::vec3 extent = 0.5f * (glm::abs(glm::vec3(transform[0])) + glm::abs(glm::vec3(transform[1])) +
+                               glm::abs(glm::vec3(transform[2])));
+    min = centre - extent;
+    max = centre + extent;
+}
+
+static void setInverseRows(const glm::mat4 &transform, glm::vec4 *rows)
+{
+    glm::mat4 inverse = glm::inverse(transform);
+    for (int row = 0; row < 3; row++)
+        rows[row] = glm::vec4(inverse[0][row], inverse[1][row], inverse[2][row], inverse[3][row]);
+}
+
+void PrismBVH::build(const Scene &scene)
+{
+    nodes.clear();
+    prisms.clear();
+    maxDepth = 0;
+
+    std::vector<glm::mat4> transforms;
+    sceneWorldTransforms(scene, transforms);
+
+    std::vector<BuildItem> items(scene.prisms.size());
+    for (size_t i = 0; i < scene.prisms.size(); i++)
+    {
+        prismBounds(transforms[i], items[i].min, items[i].max);
+        items[i].centroid = glm::vec3(transforms[i][3]);
+        items[i].prism = (uint32_t)i;
+    }
+
+    if (items.empty())
+        return;
+
+    nodes.reserve(2 * items.size() / BVH_MAX_LEAF_PRISMS + 1);
+    prisms.reserve(items.size());
+    buildNode(items, 0, (int)items.size(), 1);
+
+    // Leaves refer to prisms by their position in leaf order; fill in what intersecting them needs
+    std::vector<PickPrism> ordered(prisms.size());
+    for (size_t i = 0; i < prisms.size(); i++)
+    {
+        const ScenePrism &prism = scene.prisms[prisms[i].sceneIndex];
+
+        setInverseRows(transforms[prisms[i].sceneIndex], ordered[i].inverseRows);
+        ordered[i].n = prism.n;
+        ordered[i].seed = prism.seed;
+        ordered[i].sceneIndex = prisms[i].sceneIndex;
+        ordered[i].padding = 0;
+    }
+    prisms.swap(ordered);
+}
+
+void PrismBVH::refit(const SceneGraph &graph)
+{
+    // Leaves first: every prism's box and inverse transform from its world transform
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        Node &node = nodes[i];
+        if (node.count == 0)
+            continue;
+
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        for (uint32_t p = node.rightOrFirst; p < node.rightOrFirst + node.count; p++)
+        {
+            const AffineTransform &world = graph.world(graph.nodeOfPrism((uint32_t)prisms[p].sceneIndex));
+            glm::mat4 transform(1.0f);
+            for (int row = 0; row < 3; row++)
+                for (int column = 0; column < 4; column++)
+                    transform[column][row] = world.rows[row][column];
+
+            glm::vec3 min, max;
+            prismBounds(transform, min, max);
+            boundsMin = glm::min(boundsMin, min);
+            boundsMax = glm::max(boundsMax, max);
+            setInverseRows(transform, prisms[p].inverseRows);
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            node.min[k] = boundsMin[k];
+            node.max[k] = boundsMax[k];
+        }
+    }
+
+    // Children are stored after their parents, so walking backwards finishes both children before their parent
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        Node &node = nodes[i];
+        if (node.count > 0)
+            continue;
+
+        const Node &left = nodes[i + 1], &right = nodes[node.rightOrFirst];
+        for (int k = 0; k < 3; k++)
+        {
+            node.min[k] = std::min(left.min[k], right.min[k]);
+            node.max[k] = std::max(left.max[k], right.max[k]);
+        }
+    }
+}
+
+void PrismBVH::buildNode(std::vector<BuildItem> &items, int begin, int end, int depth)
+{
+    maxDepth = std::max(maxDepth, depth);
+
+    size_t index = nodes.size();
+    nodes.push_back(Node());
+
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    for (int i = begin; i < end; i++)
+    {
+        boundsMin = glm::min(boundsMin, items[i].min);
+        boundsMax = glm::max(boundsMax, items[i].max);
+        centroidMin = glm::min(centroidMin, items[i].centroid);
+        centroidMax = glm::max(centroidMax, items[i].centroid);
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        nodes[index].min[k] = boundsMin[k];
+        nodes[index].max[k] = boundsMax[k];
+    }
+
+    int count = end - begin;
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = FLT_MAX;
+
+    // Binned SAH: sweep the bins of every axis and keep the cheapest split between two of them
+    if (count > BVH_MAX_LEAF_PRISMS / 2)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            int binCounts[BVH_BINS] = {0};
+            glm::vec3 binMin[BVH_BINS], binMax[BVH_BINS];
+            for (int b = 0; b < BVH_BINS; b++)
+            {
+                binMin[b] = glm::vec3(FLT_MAX);
+                binMax[b] = glm::vec3(-FLT_MAX);
+            }
+
+            float scale = BVH_BINS / extent;
+            for (int i = begin; i < end; i++)
+            {
+                int b = std::min(BVH_BINS - 1, (int)((items[i].centroid[axis] - centroidMin[axis]) * scale));
+                binCounts[b]++;
+                binMin[b] = glm::min(binMin[b], items[i].min);
+                binMax[b] = glm::max(binMax[b], items[i].max);
+            }
+
+            // Areas and counts of everything left of each split, then the same from the right
+            float leftArea[BVH_BINS - 1];
+            int leftCount[BVH_BINS - 1];
+            glm::vec3 runningMin(FLT_MAX), runningMax(-FLT_MAX);
+            int running = 0;
+            for (int b = 0; b < BVH_BINS - 1; b++)
+            {
+                running += binCounts[b];
+                runningMin = glm::min(runningMin, binMin[b]);
+                runningMax = glm::max(runningMax, binMax[b]);
+                leftCount[b] = running;
+                leftArea[b] = running ? surfaceArea(runningMin, runningMax) : 0.0f;
+            }
+
+            runningMin = glm::vec3(FLT_MAX);
+            runningMax = glm::vec3(-FLT_MAX);
+            running = 0;
+            for (int b = BVH_BINS - 1; b > 0; b--)
+            {
+                running += binCounts[b];
+                runningMin = glm::min(runningMin, binMin[b]);
+                runningMax = glm::max(runningMax, binMax[b]);
+                if (leftCount[b - 1] == 0 || running == 0)
+                    continue;
+
+                float cost = leftArea[b - 1] * leftCount[b - 1] + surfaceArea(runningMin, runningMax) * running;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+    }
+
+    // Stay a leaf when splitting does not pay off, as far as the leaf size allows
+    float leafCost = surfaceArea(boundsMin, boundsMax) * (count - BVH_TRAVERSAL_COST);
+    bool leaf = count <= BVH_MAX_LEAF_PRISMS && (bestAxis < 0 || bestCost >= leafCost);
+
+    if (leaf)
+    {
+        nodes[index].rightOrFirst = (uint32_t)prisms.size();
+        nodes[index].count = (uint32_t)count;
+        for (int i = begin; i < end; i++)
+        {
+            PickPrism prism = PickPrism();
+            prism.sceneIndex = (int)items[i].prism;
+            prisms.push_back(prism);
+        }
+        return;
+    }
+
+    int middle;
+    if (bestAxis >= 0)
+    {
+        float low = centroidMin[bestAxis];
+        float scale = BVH_BINS / (centroidMax[bestAxis] - low);
+        middle = (int)(std::partition(items.begin() + begin, items.begin() + end,
+                                      [&](const BuildItem &item) {
+                                          return std::min(BVH_BINS - 1, (int)((item.centroid[bestAxis] - low) * scale)) < bestSplit;
+                                      }) -
+                       items.begin());
+    }
+    else
+    {
+        // All centroids in one spot: any split is as good as another
+        middle = begin + count / 2;
+    }
+
+    nodes[index].count = 0;
+    buildNode(items, begin, middle, depth + 1);
+    nodes[index].rightOrFirst = (uint32_t)nodes.size();
+    buildNode(items, middle, end, depth + 1);
+}
+
+// Distance at which the ray enters the box, or FLT_MAX if it misses it or the box is farther than limit
+static inline float enterBox(const float *min, const float *max, const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                             float limit)
+{
+    float t0 = (min[0] - origin.x) * inverseDirection.x, t1 = (max[0] - origin.x) * inverseDirection.x;
+    float enter = std::min(t0, t1), exit = std::max(t0, t1);
+
+    t0 = (min[1] - origin.y) * inverseDirection.y;
+    t1 = (max[1] - origin.y) * inverseDirection.y;
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+
+    t0 = (min[2] - origin.z) * inverseDirection.z;
+    t1 = (max[2] - origin.z) * inverseDirection.z;
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+
+    if (exit < std::max(enter, 0.0f) || enter >= limit)
+        return FLT_MAX;
+    return enter;
+}
+
+bool PrismBVH::pick(const glm::vec3 &origin, const glm::vec3 &direction, PickResult &result) const
+{
+    result.prism = -1;
+    if (nodes.empty())
+        return false;
+
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float closest = FLT_MAX;
+    int closestPrism = -1, closestFace = 0;
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    uint32_t current = 0;
+
+    if (enterBox(nodes[0].min, nodes[0].max, origin, inverseDirection, closest) == FLT_MAX)
+        return false;
+
+    while (true)
+    {
+        const Node &node = nodes[current];
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.rightOrFirst; i < node.rightOrFirst + node.count; i++)
+            {
+                const PickPrism &prism = prisms[i];
+                glm::vec4 o(origin, 1.0f), d(direction, 0.0f);
+                glm::vec3 localOrigin(glm::dot(prism.inverseRows[0], o), glm::dot(prism.inverseRows[1], o), glm::dot(prism.inverseRows[2], o));
+                glm::vec3 localDirection(glm::dot(prism.inverseRows[0], d), glm::dot(prism.inverseRows[1], d),
+                                         glm::dot(prism.inverseRows[2], d));
+
+                float distance;
+                int face;
+                if (intersectPrism(prism.n, localOrigin, localDirection, distance, face) && distance < closest)
+                {
+                    closest = distance;
+                    closestPrism = (int)i;
+                    closestFace = face;
+                }
+            }
+        }
+        else
+        {
+            // Visit the nearer child first and come back for the other one if it could still hold something closer
+            uint32_t left = current + 1, right = node.rightOrFirst;
+            float leftDistance = enterBox(nodes[left].min, nodes[left].max, origin, inverseDirection, closest);
+            float rightDistance = enterBox(nodes[right].min, nodes[right].max, origin, inverseDirection, closest);
+
+            if (leftDistance > rightDistance)
+            {
+                std::swap(left, right);
+                std::swap(leftDistance, rightDistance);
+            }
+
+            if (leftDistance != FLT_MAX)
+            {
+                if (rightDistance != FLT_MAX && stackSize < 64)
+                    stack[stackSize++] = right;
+                current = left;
+                continue;
+            }
+        }
+
+        // Pop the next node that can still beat the closest hit
+        bool found = false;
+        while (stackSize > 0 && !found)
+        {
+            current = stack[--stackSize];
+            found = enterBox(nodes[current].min, nodes[current].max, origin, inverseDirection, closest) != FLT_MAX;
+        }
+        if (!found)
+            break;
+    }
+
+    if (closestPrism < 0)
+        return false;
+
+    const PickPrism &prism = prisms[closestPrism];
+    result.prism = prism.sceneIndex;
+    result.face = closestFace;
+    result.distance = closest;
+    result.point = origin + closest * direction;
+    result.color = faceColor(prism.seed, (uint32_t)closestFace);
+    return true;
+}
+
+// Sector of the prism's cross-section a point falls in: sector i lies between corners i and i + 1, and side i is
+// its outer edge
+static inline int prismSector(int n, float x, float y)
+{
+    float angle = atan2f(y, x);
+    if (angle < 0.0f)
+        angle += 2.0f * (float)M_PI;
+
+    int sector = (int)(angle * n / (2.0f * (float)M_PI));
+    return sector < n ? sector : n - 1;
+}
+
+static inline glm::vec2 sideNormal(int n, int side)
+{
+    double angle = 2 * M_PI * (side + 0.5) / n;
+    return glm::vec2((float)cos(angle), (float)sin(angle));
+}
+
+bool intersectPrism(int n, const glm::vec3 &origin, const glm::vec3 &direction, float &distance, int &face)
+{
+    const float radius = 0.5f;
+    const float epsilon = 1e-5f;
+    float apothem = radius * (float)cos(M_PI / n);
+
+    // Cap slab
+    float slabEnter = -FLT_MAX, slabExit = FLT_MAX;
+    if (fabsf(direction.z) > 0.0f)
+    {
+        float t0 = (0.5f - origin.z) / direction.z, t1 = (-0.5f - origin.z) / direction.z;
+        slabEnter = std::min(t0, t1);
+        slabExit = std::max(t0, t1);
+    }
+    else if (fabsf(origin.z) > 0.5f)
+        return false;
+
+    glm::vec2 o(origin.x, origin.y), d(direction.x, direction.y);
+    float sideEnter = -FLT_MAX;
+    int enterSide = -1;
+    bool found = false;
+
+    // Large n: the ray enters the cross-section close to where it enters the circumscribed circle. Start from that
+    // sector and follow the sector of each side plane's crossing until it is the side's own; that crossing is then
+    // on the polygon's edge.
+    float dd = glm::dot(d, d);
+    if (n > PICK_SCAN_SIDES && dd > 0.0f)
+    {
+        float b = glm::dot(o, d), c = glm::dot(o, o) - radius * radius;
+        float discriminant = b * b - dd * c;
+        if (discriminant < 0.0f)
+            return false;
+
+        float t = (-b - sqrtf(discriminant)) / dd;
+        glm::vec2 p = o + t * d;
+        int side = prismSector(n, p.x, p.y);
+
+        for (int step = 0; step < 8 && !found; step++)
+        {
+            glm::vec2 normal = sideNormal(n, side);
+            float denominator = glm::dot(d, normal);
+            if (denominator >= 0.0f)
+                break;
+
+            t = (apothem - glm::dot(o, normal)) / denominator;
+            p = o + t * d;
+            int next = prismSector(n, p.x, p.y);
+            if (next == side)
+            {
+                sideEnter = t;
+                enterSide = side;
+                found = true;
+            }
+            side = next;
+        }
+    }
+
+    // Small n, or the walk did not settle: clip the ray against every side
+    if (!found)
+    {
+        float sideExit = FLT_MAX;
+        for (int side = 0; side < n; side++)
+        {
+            glm::vec2 normal = sideNormal(n, side);
+            float denominator = glm::dot(d, normal);
+            float numerator = apothem - glm::dot(o, normal);
+
+            if (denominator == 0.0f)
+            {
+                if (numerator < 0.0f)
+                    return false;
+                continue;
+            }
+
+            float t = numerator / denominator;
+            if (denominator < 0.0f)
+            {
+                if (t > sideEnter)
+                {
+                    sideEnter = t;
+                    enterSide = side;
+                }
+            }
+            else
+                sideExit = std::min(sideExit, t);
+        }
+
+        if (sideEnter > sideExit)
+            return false;
+    }
+
+    float enter = std::max(sideEnter, slabEnter);
+    if (enter < 0.0f || enter > slabExit + epsilon)
+        return false;
+
+    if (slabEnter >= sideEnter)
+    {
+        // Entering through a cap: the point has to be inside the cross-section
+        glm::vec2 p = o + enter * d;
+        int sector = prismSector(n, p.x, p.y);
+        if (glm::dot(p, sideNormal(n, sector)) > apothem + epsilon)
+            return false;
+        face = direction.z < 0.0f ? 0 : 1;
+    }
+    else
+        face = 2 + enterSide;
+
+    distance = enter;
+    return true;
+}
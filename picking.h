@@ -0,0 +1,92 @@
+#ifndef PICKING_H
+#define PICKING_H
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "scene_graph.h"
+
+struct PickResult
+{
+    int prism;        // Index into the scene, -1 for a miss
+    int face;         // 0 top cap, 1 bottom cap, 2 to n + 1 sides
+    float distance;   // Along the ray, in units of its direction
+    glm::vec3 point;  // Where the ray hits, in scene space
+    glm::vec3 color;  // faceColor() of the face
+};
+
+// Ray through a point of the viewport, in scene space (before model is applied). x and y are in [0, 1] from the
+// top left corner, as GLFW reports cursor positions.
+void viewportRay(float x, float y, const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection,
+                 glm::vec3 &origin, glm::vec3 &direction);
+
+// Bounding volume hierarchy for picking scene prisms
+// --------------------------------------------------
+// Built top-down over the prisms' world-space boxes with a binned surface area heuristic, and stored depth-first
+// in one array of 32-byte nodes: a node's left child follows it, and only the right child's index is stored.
+// Leaves point at a run of prisms, copied into leaf order along with their inverse transforms so that a leaf's
+// data is contiguous. Rays are tested against prisms analytically, as the intersection of the cap slab with the
+// n side half-planes; for large n the entry side is found from the angle of the entry point instead of testing
+// every side.
+class PrismBVH
+{
+public:
+    PrismBVH();
+
+    void build(const Scene &scene);
+
+    // Bring the tree up to date with prisms that moved, keeping its structure: every box and inverse transform is
+    // recomputed from the graph's world transforms. The tree gets looser the farther prisms move from where it was
+    // built, but picks stay exact.
+    void refit(const SceneGraph &graph);
+
+    // Closest prism along the ray from origin; returns false if it hits none
+    bool pick(const glm::vec3 &origin, const glm::vec3 &direction, PickResult &result) const;
+
+    size_t nodeCount() const
+    {
+        return nodes.size();
+    }
+
+    int depth() const
+    {
+        return maxDepth;
+    }
+
+private:
+    struct Node
+    {
+        float min[3];
+        uint32_t rightOrFirst; // Interior: index of the right child; leaf: first prism
+        float max[3];
+        uint32_t count;        // Prisms in a leaf, 0 for an interior node
+    };
+
+    // What intersecting a prism needs: scene to object space as three rows of a 3x4 affine, sides and seed
+    struct PickPrism
+    {
+        glm::vec4 inverseRows[3];
+        int n;
+        uint32_t seed;
+        int sceneIndex;
+        int padding;
+    };
+
+    struct BuildItem
+    {
+        glm::vec3 min, max, centroid;
+        uint32_t prism;
+    };
+
+    void buildNode(std::vector<BuildItem> &items, int begin, int end, int depth);
+
+    std::vector<Node> nodes;
+    std::vector<PickPrism> prisms;
+    int maxDepth;
+};
+
+// Ray against the n-sided prism at the origin (side 0.5 from the axis to the corners, caps at z = +-0.5); returns
+// the distance to where it enters and the face it enters through, or false if it misses or starts inside
+bool intersectPrism(int n, const glm::vec3 &origin, const glm::vec3 &direction, float &distance, int &face);
+
+#endif
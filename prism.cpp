@@ -0,0 +1,191 @@
+#include "prism.h"
+#include <math.h>
+
+// Faces per job when generating in parallel
+const int PRISM_FACE_GRAIN = 4096;
+
+static inline void writeVertex(float *out, const float *point, const glm::vec3 &color)
+{
+    out[0] = point[0];
+    out[1] = point[1];
+    out[2] = point[2];
+    out[3] = color.r;
+    out[4] = color.g;
+    out[5] = color.b;
+}
+
+static inline void writeTriangle(uint32_t *out, uint32_t a, uint32_t b, uint32_t c)
+{
+    out[0] = a;
+    out[1] = b;
+    out[2] = c;
+}
+
+// Point i of the top ring; the bottom ring is the same with z - 1
+static inline void ringPoint(int n, int i, glm::vec3 centre, float *point)
+{
+    point[0] = centre.x + cos(2 * M_PI * i / n) * 0.5f;
+    point[1] = centre.y + sin(2 * M_PI * i / n) * 0.5f;
+    point[2] = centre.z + 0.5f;
+}
+
+// Cap rings: point i of the top ring is vertex i, point i of the bottom ring is vertex n + i
+static void writeRings(int n, glm::vec3 centre, uint32_t seed, float *vertices, int begin, int end)
+{
+    glm::vec3 topColor = faceColor(seed, 0);
+    glm::vec3 bottomColor = faceColor(seed, 1);
+
+    for (int i = begin; i < end; i++)
+    {
+        float point[3];
+        ringPoint(n, i, centre, point);
+
+        writeVertex(&vertices[6 * i], point, topColor);
+        point[2] = centre.z - 0.5f;
+        writeVertex(&vertices[6 * (n + i)], point, bottomColor);
+    }
+}
+
+// Generating figure: triangle i of each cap fans out from the cap's first point
+static void writeCaps(int n, uint32_t baseVertex, uint32_t *indices, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        writeTriangle(&indices[3 * i], baseVertex, baseVertex + i + 1, baseVertex + i + 2);
+        writeTriangle(&indices[3 * (n - 2) + 3 * i], baseVertex + n, baseVertex + n + i + 1, baseVertex + n + i + 2);
+    }
+}
+
+// Side i is the quad of vertices 2n + 4i to 2n + 4i + 3, split along its diagonal
+static void writeSideIndices(int n, uint32_t baseVertex, uint32_t *indices, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        uint32_t first = baseVertex + 2 * n + 4 * i;
+        uint32_t *quad = &indices[6 * (n - 2) + 6 * i];
+
+        writeTriangle(quad, first, first + 1, first + 2);
+        writeTriangle(quad + 3, first, first + 3, first + 2);
+    }
+}
+
+// Side i is the quad between points i and i + 1 of both rings, wrapping around after the last one. Its colour
+// depends only on its face index, so any range of sides can be written on its own once the rings exist.
+static void writeSides(int n, uint32_t seed, uint32_t baseVertex, float *vertices, uint32_t *indices, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        int next = (i + 1) % n;
+        float *side = &vertices[6 * (2 * n + 4 * i)]; // After both cap rings
+        glm::vec3 color = faceColor(seed, i + 2);
+
+        writeVertex(side, &vertices[6 * i], color);
+        writeVertex(side + 6, &vertices[6 * next], color);
+        writeVertex(side + 12, &vertices[6 * (n + next)], color);
+        writeVertex(side + 18, &vertices[6 * (n + i)], color);
+    }
+
+    writeSideIndices(n, baseVertex, indices, begin, end);
+}
+
+static void writeFaceColors(int n, uint32_t seed, float *faceColors)
+{
+    for (int face = 0; face < n + 2; face++)
+    {
+        glm::vec3 color = faceColor(seed, face);
+        faceColors[3 * face] = color.r;
+        faceColors[3 * face + 1] = color.g;
+        faceColors[3 * face + 2] = color.b;
+    }
+}
+
+void generatePrism(int n, glm::vec3 centre, uint32_t seed, PrismMesh &mesh, JobSystem &jobs)
+{
+    mesh.vertices.resize(6 * prismVertexCount(n));
+    mesh.indices.resize(prismIndexCount(n));
+    mesh.faceColors.resize(3 * (n + 2));
+
+    float *vertices = mesh.vertices.data();
+    uint32_t *indices = mesh.indices.data();
+
+    writeFaceColors(n, seed, mesh.faceColors.data());
+
+    jobs.parallelFor(0, n, PRISM_FACE_GRAIN, [&](int begin, int end) { writeRings(n, centre, seed, vertices, begin, end); });
+    jobs.parallelFor(0, n - 2, PRISM_FACE_GRAIN, [&](int begin, int end) { writeCaps(n, 0, indices, begin, end); });
+    jobs.parallelFor(0, n, PRISM_FACE_GRAIN,
+                     [&](int begin, int end) { writeSides(n, seed, 0, vertices, indices, begin, end); });
+}
+
+void colorPrismShape(int n, const ShapeView &shape, uint32_t seed, PrismMesh &mesh, JobSystem &jobs)
+{
+    mesh.vertices.resize(6 * shape.vertexCount);
+    mesh.indices.assign(shape.indices, shape.indices + shape.indexCount);
+    mesh.faceColors.resize(3 * (n + 2));
+    writeFaceColors(n, seed, mesh.faceColors.data());
+
+    float *vertices = mesh.vertices.data();
+    const float *faceColors = mesh.faceColors.data();
+    jobs.parallelFor(0, shape.vertexCount, PRISM_FACE_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            const PrismShapeVertex &in = shape.vertices[i];
+            const float *color = &faceColors[3 * in.face];
+            writeVertex(&vertices[6 * i], in.position, glm::vec3(color[0], color[1], color[2]));
+        }
+    });
+}
+
+void writePrism(int n, uint32_t seed, uint32_t baseVertex, float *vertices, uint32_t *indices, float *faceColors)
+{
+    writeFaceColors(n, seed, faceColors);
+    writeRings(n, glm::vec3(0.0f), seed, vertices, 0, n);
+    writeCaps(n, baseVertex, indices, 0, n - 2);
+    writeSides(n, seed, baseVertex, vertices, indices, 0, n);
+}
+
+// Shape vertices carry the face number where the coloured ones carry the colour
+static inline void writeShapeVertex(PrismShapeVertex &out, const float *point, uint32_t face)
+{
+    out.position[0] = point[0];
+    out.position[1] = point[1];
+    out.position[2] = point[2];
+    out.face = face;
+}
+
+void generatePrismShape(int n, PrismShape &shape, JobSystem &jobs)
+{
+    shape.vertices.resize(prismVertexCount(n));
+    shape.indices.resize(prismIndexCount(n));
+
+    PrismShapeVertex *vertices = shape.vertices.data();
+    uint32_t *indices = shape.indices.data();
+
+    jobs.parallelFor(0, n, PRISM_FACE_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            float point[3];
+            ringPoint(n, i, glm::vec3(0.0f), point);
+            writeShapeVertex(vertices[i], point, 0);
+
+            point[2] = -0.5f;
+            writeShapeVertex(vertices[n + i], point, 1);
+        }
+    });
+
+    jobs.parallelFor(0, n - 2, PRISM_FACE_GRAIN, [&](int begin, int end) { writeCaps(n, 0, indices, begin, end); });
+
+    jobs.parallelFor(0, n, PRISM_FACE_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            int next = (i + 1) % n;
+            PrismShapeVertex *side = &vertices[2 * n + 4 * i];
+
+            writeShapeVertex(side[0], vertices[i].position, i + 2);
+            writeShapeVertex(side[1], vertices[next].position, i + 2);
+            writeShapeVertex(side[2], vertices[n + next].position, i + 2);
+            writeShapeVertex(side[3], vertices[n + i].position, i + 2);
+        }
+
+        writeSideIndices(n, 0, indices, begin, end);
+    });
+}
@@ -0,0 +1,152 @@
+#ifndef PRISM_H
+#define PRISM_H
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "job_system.h"
+
+// Indexed mesh of an n-sided prism: each cap has its own ring of n vertices and each side its own 4, so that every
+// face keeps a flat colour; the caps are fanned (n - 2 triangles each) and every side is two triangles
+inline int prismVertexCount(int n)
+{
+    return 2 * n + 4 * n;
+}
+
+inline int prismIndexCount(int n)
+{
+    return 6 * (n - 2) + 6 * n;
+}
+
+// Side vertices repeat ring positions: returns the cap ring vertex (0 to 2n - 1) at the same position as vertex
+inline int prismPositionIndex(int n, int vertex)
+{
+    if (vertex < 2 * n)
+        return vertex;
+
+    int side = (vertex - 2 * n) / 4;
+    int next = (side + 1) % n;
+    switch ((vertex - 2 * n) % 4)
+    {
+    case 0:
+        return side;
+    case 1:
+        return next;
+    case 2:
+        return n + next;
+    default:
+        return n + side;
+    }
+}
+
+// Face a triangle of the index list belongs to: the top cap's triangles, the bottom cap's, then two per side
+inline int prismTriangleFace(int n, int triangle)
+{
+    if (triangle < n - 2)
+        return 0;
+    if (triangle < 2 * (n - 2))
+        return 1;
+    return 2 + (triangle - 2 * (n - 2)) / 2;
+}
+
+// Interleaved position/RGB vertices, a triangle list of indices into them and one RGB colour per face
+struct PrismMesh
+{
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> faceColors;
+};
+
+// Read-only view of a coloured mesh, such as a PrismMesh
+struct MeshView
+{
+    const float *vertices;
+    int vertexCount;
+    const uint32_t *indices;
+    int indexCount;
+    const float *faceColors;
+    int faceCount;
+};
+
+// Geometry every prism with the same number of sides shares: positions of the prism at the origin and the face
+// each vertex belongs to, with colours left to whoever draws it. Same vertex and index layout as PrismMesh.
+struct PrismShapeVertex
+{
+    float position[3];
+    uint32_t face;
+};
+
+struct PrismShape
+{
+    std::vector<PrismShapeVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct ShapeView
+{
+    const PrismShapeVertex *vertices;
+    int vertexCount;
+    const uint32_t *indices;
+    int indexCount;
+};
+
+inline ShapeView shapeView(const PrismShape &shape)
+{
+    ShapeView view = {shape.vertices.data(), (int)shape.vertices.size(), shape.indices.data(), (int)shape.indices.size()};
+    return view;
+}
+
+// Sides of a prism's level of detail: every level halves the sides, down to a triangle
+inline int prismLodSides(int n, int lod)
+{
+    int sides = n >> lod;
+    return sides > 3 ? sides : 3;
+}
+
+inline MeshView meshView(const PrismMesh &mesh)
+{
+    MeshView view = {mesh.vertices.data(), (int)(mesh.vertices.size() / 6), mesh.indices.data(), (int)mesh.indices.size(),
+                     mesh.faceColors.data(), (int)(mesh.faceColors.size() / 3)};
+    return view;
+}
+
+// 32-bit integer hash (lowbias32). It only uses 32-bit multiplies, shifts and xors, so a shader can reproduce it
+// bit for bit with uint arithmetic.
+inline uint32_t hash32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// Colour of one face, computed from the seed and the face index alone: channel k is
+// hash32(hash32(seed) + 3 * face + k), with its top 24 bits mapped onto [0, 1]
+inline glm::vec3 faceColor(uint32_t seed, uint32_t face)
+{
+    uint32_t key = hash32(seed) + 3 * face;
+    const float scale = 1.0f / 16777215.0f;
+
+    return glm::vec3((float)(hash32(key) >> 8) * scale, (float)(hash32(key + 1) >> 8) * scale,
+                     (float)(hash32(key + 2) >> 8) * scale);
+}
+
+// Fill mesh with an n-sided prism centred at centre. The caps come first (faces 0 and 1), then the sides in order
+// around the prism (faces 2 to n + 1); every face is coloured with faceColor(seed, face).
+void generatePrism(int n, glm::vec3 centre, uint32_t seed, PrismMesh &mesh, JobSystem &jobs);
+
+// Fill shape with the n-sided prism at the origin, faces numbered as above
+void generatePrismShape(int n, PrismShape &shape, JobSystem &jobs);
+
+// Fill mesh with the coloured prism of n sides whose shape is given, every vertex taking faceColor(seed, face) of its
+// face; the same mesh as generatePrism() at the origin
+void colorPrismShape(int n, const ShapeView &shape, uint32_t seed, PrismMesh &mesh, JobSystem &jobs);
+
+// Same prism at the origin, written serially into caller-provided arrays of prismVertexCount(n) vertices,
+// prismIndexCount(n) indices and n + 2 face colours; baseVertex is added to every index. For building many small
+// prisms from one job.
+void writePrism(int n, uint32_t seed, uint32_t baseVertex, float *vertices, uint32_t *indices, float *faceColors);
+
+#endif
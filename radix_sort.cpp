@@ -0,0 +1,82 @@
+#include "radix_sort.h"
+#include <string.h>
+
+// Turn a histogram of one byte into the first output position of every value; returns false if every key has the
+// same value, in which case the pass can be skipped
+static bool prefixSums(size_t histogram[256], size_t count)
+{
+    size_t offset = 0;
+    for (int digit = 0; digit < 256; digit++)
+    {
+        size_t digitCount = histogram[digit];
+        if (digitCount == count)
+            return false;
+
+        histogram[digit] = offset;
+        offset += digitCount;
+    }
+    return true;
+}
+
+void radixSort(std::vector<uint64_t> &keys, std::vector<uint64_t> &scratch)
+{
+    size_t count = keys.size();
+    if (count < 2)
+        return;
+
+    scratch.resize(count);
+    uint64_t *from = keys.data();
+    uint64_t *to = scratch.data();
+
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t histogram[256];
+        memset(histogram, 0, sizeof(histogram));
+        for (size_t i = 0; i < count; i++)
+            histogram[(from[i] >> shift) & 0xFF]++;
+
+        if (!prefixSums(histogram, count))
+            continue;
+
+        for (size_t i = 0; i < count; i++)
+            to[histogram[(from[i] >> shift) & 0xFF]++] = from[i];
+
+        uint64_t *swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != keys.data())
+        memcpy(keys.data(), from, count * sizeof(uint64_t));
+}
+
+void radixSortIndices(const uint16_t *keys, size_t count, std::vector<uint32_t> &order, std::vector<uint32_t> &scratch)
+{
+    order.resize(count);
+    scratch.resize(count);
+
+    size_t low[256], high[256];
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+    for (size_t i = 0; i < count; i++)
+    {
+        low[keys[i] & 0xFF]++;
+        high[keys[i] >> 8]++;
+    }
+
+    bool sortLow = count > 1 && prefixSums(low, count);
+    bool sortHigh = count > 1 && prefixSums(high, count);
+
+    // Low byte first, straight from the identity order; the high byte pass then reads the result of the first
+    uint32_t *first = sortHigh ? scratch.data() : order.data();
+    if (sortLow)
+        for (size_t i = 0; i < count; i++)
+            first[low[keys[i] & 0xFF]++] = (uint32_t)i;
+    else
+        for (size_t i = 0; i < count; i++)
+            first[i] = (uint32_t)i;
+
+    if (sortHigh)
+        for (size_t i = 0; i < count; i++)
+            order[high[keys[first[i]] >> 8]++] = first[i];
+}
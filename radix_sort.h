@@ -0,0 +1,19 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// LSD radix sorts
+// ---------------
+// O(n) sorts a byte at a time through a caller-owned scratch buffer, so that sorting every frame does not allocate
+// once the buffers have grown. Passes over a byte that every key has in common are skipped.
+
+// Sort keys in place
+void radixSort(std::vector<uint64_t> &keys, std::vector<uint64_t> &scratch);
+
+// Fill order with 0 to count - 1, ordered by keys[i]; items with equal keys keep their relative order
+void radixSortIndices(const uint16_t *keys, size_t count, std::vector<uint32_t> &order, std::vector<uint32_t> &scratch);
+
+#endif
@@ -0,0 +1,19 @@
+#include "render_queue.h"
+#include "radix_sort.h"
+
+void RenderQueue::clear()
+{
+    keys.clear();
+    commands.clear();
+}
+
+void RenderQueue::push(uint64_t key, const DrawCommand &command)
+{
+    keys.push_back(key | commands.size());
+    commands.push_back(command);
+}
+
+void RenderQueue::sort()
+{
+    radixSort(keys, scratch);
+}
@@ -0,0 +1,156 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <stdint.h>
+#include <vector>
+#include "mesh_registry.h"
+
+// One instanced draw: a mesh and the range of the stream buffer holding its instances
+struct DrawCommand
+{
+    unsigned int program;
+    const GpuMesh *mesh;
+    GLintptr instanceOffset;
+    GLsizei instanceCount;
+};
+
+// Sort keys
+// ---------
+// From the most significant bits down: program (8 bits), arena (16), depth bucket (16), then the command's
+// position in the queue (24) so that keys are unique and lead back to their command. Sorting by key groups draws by
+// the state they need, most expensive to change first, and orders them near to far within the same state.
+const int SORT_KEY_INDEX_BITS = 24;
+
+inline uint64_t drawSortKey(unsigned int programSlot, unsigned int arena, unsigned int depthBucket)
+{
+    return ((uint64_t)(programSlot & 0xFF) << 56) | ((uint64_t)(arena & 0xFFFF) << 40) | ((uint64_t)(depthBucket & 0xFFFF) << 24);
+}
+
+// Draw commands of one frame, submitted in key order
+class RenderQueue
+{
+public:
+    static const size_t MAX_COMMANDS = (size_t)1 << SORT_KEY_INDEX_BITS;
+
+    void clear();
+
+    // Queue a command under key, which must leave the low SORT_KEY_INDEX_BITS bits clear
+    void push(uint64_t key, const DrawCommand &command);
+
+    // Radix sort the commands by key
+    void sort();
+
+    size_t size() const
+    {
+        return keys.size();
+    }
+
+    // i-th command in sorted order
+    const DrawCommand &operator[](size_t i) const
+    {
+        return commands[keys[i] & (MAX_COMMANDS - 1)];
+    }
+
+private:
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> scratch;
+    std::vector<DrawCommand> commands;
+};
+
+// Binds issued and binds skipped because the state was already set, and every GL call made through the cache or
+// counted into it with countCalls(), binds included
+struct StateCacheStats
+{
+    unsigned long long binds;
+    unsigned long long bindsAvoided;
+    unsigned long long calls;
+};
+
+// GL state cache
+// --------------
+// Remembers the program, VAO, array buffer and uniform block range last bound through it and drops binds that would
+// not change anything. It only knows about binds made through it, so invalidate() it whenever something else may
+// have touched GL state, such as at the start of every frame.
+class GLStateCache
+{
+public:
+    GLStateCache()
+    {
+        invalidate();
+        counters.binds = counters.bindsAvoided = counters.calls = 0;
+    }
+
+    void invalidate()
+    {
+        program = vertexArray = arrayBuffer = uniformBuffer = 0;
+        uniformOffset = -1;
+        uniformSize = 0;
+    }
+
+    void useProgram(unsigned int name)
+    {
+        if (count(name == program))
+            return;
+        glUseProgram(name);
+        program = name;
+    }
+
+    void bindVertexArray(unsigned int name)
+    {
+        if (count(name == vertexArray))
+            return;
+        glBindVertexArray(name);
+        vertexArray = name;
+    }
+
+    void bindArrayBuffer(unsigned int name)
+    {
+        if (count(name == arrayBuffer))
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, name);
+        arrayBuffer = name;
+    }
+
+    // Only binding point 0 is tracked, which is the only one in use
+    void bindUniformRange(unsigned int name, GLintptr offset, GLsizeiptr size)
+    {
+        if (count(name == uniformBuffer && offset == uniformOffset && size == uniformSize))
+            return;
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, name, offset, size);
+        uniformBuffer = name;
+        uniformOffset = offset;
+        uniformSize = size;
+    }
+
+    // Count GL calls made directly, next to the calls, so that stats() has every call of the frame
+    void countCalls(unsigned int calls)
+    {
+        counters.calls += calls;
+    }
+
+    const StateCacheStats &stats() const
+    {
+        return counters;
+    }
+
+private:
+    bool count(bool redundant)
+    {
+        if (redundant)
+            counters.bindsAvoided++;
+        else
+        {
+            counters.binds++;
+            counters.calls++;
+        }
+        return redundant;
+    }
+
+    unsigned int program, vertexArray, arrayBuffer, uniformBuffer;
+    GLintptr uniformOffset;
+    GLsizeiptr uniformSize;
+    StateCacheStats counters;
+};
+
+#endif
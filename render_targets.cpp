@@ -0,0 +1,86 @@
+#include "render_targets.h"
+#include <algorithm>
+
+// RGBA8 colour and 24-bit depth, padded to 32
+const unsigned long long RENDER_TARGET_BYTES_PER_PIXEL = 8;
+
+int renderTargetBucket(int size)
+{
+    return (std::max(size, 1) + RENDER_TARGET_BUCKET - 1) / RENDER_TARGET_BUCKET * RENDER_TARGET_BUCKET;
+}
+
+RenderTargetPool::RenderTargetPool()
+{
+    counters = RenderTargetStats();
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+    for (size_t i = 0; i < freeTargets.size(); i++)
+        destroy(freeTargets[i]);
+}
+
+RenderTarget *RenderTargetPool::acquire(int width, int height)
+{
+    int bucketWidth = renderTargetBucket(width);
+    int bucketHeight = renderTargetBucket(height);
+    counters.acquired++;
+
+    // The most recently released first, as that is the likeliest to be asked for again
+    for (size_t i = freeTargets.size(); i-- > 0;)
+    {
+        RenderTarget *target = freeTargets[i];
+        if (target->width == bucketWidth && target->height == bucketHeight)
+        {
+            freeTargets.erase(freeTargets.begin() + i);
+            return target;
+        }
+    }
+
+    RenderTarget *target = new RenderTarget();
+    target->width = bucketWidth;
+    target->height = bucketHeight;
+
+    glGenRenderbuffers(1, &target->color);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, bucketWidth, bucketHeight);
+    glGenRenderbuffers(1, &target->depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, bucketWidth, bucketHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depth);
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previous);
+
+    counters.allocations++;
+    counters.bytes += (unsigned long long)bucketWidth * bucketHeight * RENDER_TARGET_BYTES_PER_PIXEL;
+    return target;
+}
+
+void RenderTargetPool::release(RenderTarget *target)
+{
+    if (!target)
+        return;
+
+    freeTargets.push_back(target);
+    if ((int)freeTargets.size() > MAX_FREE)
+    {
+        destroy(freeTargets.front());
+        freeTargets.erase(freeTargets.begin());
+        counters.deleted++;
+    }
+}
+
+void RenderTargetPool::destroy(RenderTarget *target)
+{
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteRenderbuffers(1, &target->color);
+    glDeleteRenderbuffers(1, &target->depth);
+    counters.bytes -= (unsigned long long)target->width * target->height * RENDER_TARGET_BYTES_PER_PIXEL;
+    delete target;
+}
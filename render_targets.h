@@ -0,0 +1,56 @@
+#ifndef RENDER_TARGETS_H
+#define RENDER_TARGETS_H
+
+#include <glad/glad.h>
+#include <vector>
+
+// Offscreen colour and depth buffers attached to a framebuffer of their own
+struct RenderTarget
+{
+    GLuint framebuffer, color, depth;
+    int width, height; // As allocated, a whole number of buckets each
+};
+
+struct RenderTargetStats
+{
+    unsigned long long acquired;
+    unsigned long long allocations; // Acquires that found nothing of their size free and allocated a target
+    unsigned long long deleted;     // Free targets dropped to keep the pool within MAX_FREE
+    unsigned long long bytes;       // Held by all targets, in use or free
+};
+
+// Sizes are rounded up to a whole number of RENDER_TARGET_BUCKET pixels
+const int RENDER_TARGET_BUCKET = 128;
+int renderTargetBucket(int size);
+
+// Pool of render targets
+// ----------------------
+// Targets are allocated at sizes rounded up to whole buckets, so small changes in size find a target that still fits,
+// and given back to the pool rather than deleted. Acquiring a size looks for a free target of exactly its bucket,
+// which going back to a size used before will find; otherwise a new one is allocated. Only the most recently
+// released MAX_FREE targets are kept. Must be created and used on the thread that owns the context.
+class RenderTargetPool
+{
+public:
+    static const int MAX_FREE = 4;
+
+    RenderTargetPool();
+    ~RenderTargetPool();
+
+    // A target of width x height rounded up to buckets; only the bottom-left width x height of it is meant to be used
+    RenderTarget *acquire(int width, int height);
+    void release(RenderTarget *target);
+
+    const RenderTargetStats &stats() const
+    {
+        return counters;
+    }
+
+private:
+    void destroy(RenderTarget *target);
+
+    std::vector<RenderTarget *> freeTargets; // Least recently released first
+    RenderTargetStats counters;
+};
+
+#endif
@@ -0,0 +1,730 @@
+#include "renderer.h"
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <math.h>
+#include "radix_sort.h"
+
+const GLuint TRANSFORMS_BINDING = 0;
+
+// Attribute locations of the per-instance data
+const GLuint INSTANCE_ROWS_LOCATION = 2;
+const GLuint INSTANCE_SEED_LOCATION = 5;
+const GLuint INSTANCE_CULLED_LOCATION = 6; // Read from the occlusion culler's flags, only while it culls
+
+// Coarser levels of detail stop at this many sides; below it a prism is cheap enough as it is
+const int LOD_MIN_SIDES = 32;
+
+// A level of detail is used once its sides come out at most this many pixels long on screen
+const float LOD_SIDE_PIXELS = 1.0f;
+
+// Depth bucket 0 ends this far from the eye, and every doubling of the distance after it spans this many buckets
+const float DEPTH_BUCKET_NEAR = 0.5f;
+const float DEPTH_BUCKETS_PER_OCTAVE = 2.0f;
+
+// Objects whose local transforms or instance data one job writes; a multiple of the transform store's four lanes
+const int INSTANCE_WRITE_GRAIN = 16384;
+
+// Changed scene graph ranges whose objects' bounds one job updates
+const int SCENE_BOUNDS_GRAIN = 1024;
+
+// With occlusion culling on, one frame in this many is drawn without it, to time against
+const unsigned long long HIZ_REFERENCE_INTERVAL = 8;
+
+// Cell of an object outside every view's frustum, which is not drawn at all
+const uint32_t CULLED_CELL = 0xFFFFFFFFu;
+
+// Face colours are computed here from the instance's seed, exactly as faceColor() does on the CPU. Instances the
+// occlusion culler flagged are moved outside the clip volume, where all their triangles are clipped away.
+const char *vertexShaderSource = "#version 330 core\n"
+                                 "layout (location = 0) in vec3 aPos;\n"
+                                 "layout (location = 1) in uint aFace;\n"
+                                 "layout (location = 2) in vec4 aRow0;\n"
+                                 "layout (location = 3) in vec4 aRow1;\n"
+                                 "layout (location = 4) in vec4 aRow2;\n"
+                                 "layout (location = 5) in uint aSeed;\n"
+                                 "layout (location = 6) in uint aCulled;\n"
+                                 "layout (std140) uniform Transforms\n"
+                                 "{\n"
+                                 "   mat4 model;\n"
+                                 "   mat4 view;\n"
+                                 "   mat4 projection;\n"
+                                 "};\n"
+                                 "flat out vec3 inColor;\n"
+                                 "uint hash32(uint x)\n"
+                                 "{\n"
+                                 "   x ^= x >> 16;\n"
+                                 "   x *= 0x7feb352du;\n"
+                                 "   x ^= x >> 15;\n"
+                                 "   x *= 0x846ca68bu;\n"
+                                 "   x ^= x >> 16;\n"
+                                 "   return x;\n"
+                                 "}\n"
+                                 "void main()\n"
+                                 "{\n"
+                                 "   if (aCulled != 0u)\n"
+                                 "   {\n"
+                                 "      gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+                                 "      inColor = vec3(0.0);\n"
+                                 "      return;\n"
+                                 "   }\n"
+                                 "   vec4 p = vec4(aPos, 1.0);\n"
+                                 "   vec3 world = vec3(dot(aRow0, p), dot(aRow1, p), dot(aRow2, p));\n"
+                                 "   gl_Position = projection * view * model * vec4(world, 1.0);\n"
+                                 "   uint key = hash32(aSeed) + 3u * aFace;\n"
+                                 "   inColor = vec3(float(hash32(key) >> 8), float(hash32(key + 1u) >> 8), float(hash32(key + 2u) >> 8)) * (1.0 / 16777215.0);\n"
+                                 "}\0";
+
+const char *fragmentShaderSource = "#version 330 core\n"
+                                   "out vec4 FragColor;\n"
+                                   "flat in vec3 inColor;\n"
+                                   "void main()\n"
+                                   "{\n"
+                                   "   FragColor = vec4(inColor, 1.0f);\n"
+                                   "}\n\0";
+
+glm::mat4 prismProjection(float aspect)
+{
+    return glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+}
+
+// Compile one shader stage, printing any errors under the stage's name
+static unsigned int compileShader(GLenum type, const char *source, const char *stage)
+{
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    // Check for shader compile errors
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n"
+                  << infoLog << std::endl;
+    }
+
+    return shader;
+}
+
+// Build and compile a shader program
+// ----------------------------------
+unsigned int buildShaderProgram(const char *vertexSource, const char *fragmentSource, const char *geometrySource,
+                                const char *const *feedbackVaryings, int feedbackVaryingCount)
+{
+    unsigned int shaders[3];
+    int shaderCount = 0;
+
+    shaders[shaderCount++] = compileShader(GL_VERTEX_SHADER, vertexSource, "VERTEX");
+    if (geometrySource)
+        shaders[shaderCount++] = compileShader(GL_GEOMETRY_SHADER, geometrySource, "GEOMETRY");
+    if (fragmentSource)
+        shaders[shaderCount++] = compileShader(GL_FRAGMENT_SHADER, fragmentSource, "FRAGMENT");
+
+    // Link shaders
+    unsigned int shaderProgram = glCreateProgram();
+    for (int i = 0; i < shaderCount; i++)
+        glAttachShader(shaderProgram, shaders[i]);
+    if (feedbackVaryingCount > 0)
+        glTransformFeedbackVaryings(shaderProgram, feedbackVaryingCount, feedbackVaryings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(shaderProgram);
+
+    // Check for linking errors
+    int success;
+    char infoLog[512];
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
+                  << infoLog << std::endl;
+    }
+
+    for (int i = 0; i < shaderCount; i++)
+        glDeleteShader(shaders[i]);
+
+    return shaderProgram;
+}
+
+PrismRenderer::PrismRenderer(const Scene &scene, const char *meshCache) : registry(meshCache, *jobSystem)
+{
+    shaderProgram = buildShaderProgram(vertexShaderSource, fragmentShaderSource);
+    glEnable(GL_DEPTH_TEST);
+
+    glUniformBlockBinding(shaderProgram, glGetUniformBlockIndex(shaderProgram, "Transforms"), TRANSFORMS_BINDING);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    viewportWidth = viewport[2];
+    viewportHeight = viewport[3];
+    overdraw = OverdrawStats();
+    overdraw.pixels = (unsigned long long)viewport[2] * viewport[3];
+
+    measureOverdraw = false;
+    overdrawFrames = 0;
+    overdrawPending[0] = overdrawPending[1] = false;
+    glGenQueries(2, overdrawQueries);
+
+    culler = NULL;
+    callsCounted = 0;
+    cullingFrames = 0;
+    cullingTimes = CullingTimeStats();
+    frameDraws = FrameDrawStats();
+    frameTimers = new GpuTimerRing(FRAME_TIMER_COUNT, 2);
+
+    // Per-frame data goes through a fenced ring instead of glUniform*/glBufferData
+    stream = new StreamBuffer(64 * 1024);
+
+    // Every object holds a reference to the mesh of each of its levels of detail; objects only differ in the
+    // instance data they are drawn with, which comes from their world transforms in the scene graph. Objects are
+    // in scene graph node order.
+    std::map<GpuMesh *, int> batchIndices;
+    objects.resize(scene.prisms.size());
+    graph.build(scene);
+    transforms.build(scene, graph);
+    spin = appliedSpin = 0.0f;
+
+    for (size_t i = 0; i < scene.prisms.size(); i++)
+    {
+        const ScenePrism &prism = scene.prisms[graph.prismOfNode((uint32_t)i)];
+        SceneObject &object = objects[i];
+        object.seed = prism.seed;
+        updateBounds((uint32_t)i);
+
+        object.lodCount = 0;
+        for (int lod = 0; lod < MAX_LOD_LEVELS; lod++)
+        {
+            if (lod > 0 && (prism.n >> lod) < LOD_MIN_SIDES)
+                break;
+
+            GpuMesh *mesh = registry.acquire(prism.n, lod);
+            std::map<GpuMesh *, int>::iterator it = batchIndices.find(mesh);
+            if (it == batchIndices.end())
+            {
+                it = batchIndices.insert(std::make_pair(mesh, (int)batches.size())).first;
+                batches.push_back(Batch());
+                batches.back().mesh = mesh;
+            }
+
+            object.lods[object.lodCount++] = it->second;
+        }
+    }
+
+    // Instances are fed from the stream buffer, one set of attributes per instance; this is VAO state, set once
+    // for every arena in use. The culling flags are per instance too, but only enabled on frames that are culled.
+    for (size_t i = 0; i < batches.size(); i++)
+    {
+        glBindVertexArray(batches[i].mesh->VAO);
+        for (GLuint location = INSTANCE_ROWS_LOCATION; location <= INSTANCE_SEED_LOCATION; location++)
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glVertexAttribDivisor(INSTANCE_CULLED_LOCATION, 1);
+    }
+    glBindVertexArray(0);
+}
+
+PrismRenderer::~PrismRenderer()
+{
+    // De-allocate all resources once they've outlived their purpose
+    // -------------------------------------------------------------
+    for (size_t i = 0; i < objects.size(); i++)
+        for (int lod = 0; lod < objects[i].lodCount; lod++)
+            registry.release(batches[objects[i].lods[lod]].mesh);
+
+    delete stream;
+    delete culler;
+    glDeleteQueries(2, overdrawQueries);
+    delete frameTimers;
+    glDeleteProgram(shaderProgram);
+}
+
+void PrismRenderer::setViewport(int width, int height)
+{
+    glViewport(0, 0, width, height);
+    state.countCalls(1);
+    viewportWidth = width;
+    viewportHeight = height;
+    overdraw.pixels = (unsigned long long)width * height;
+}
+
+void PrismRenderer::setOverdrawMeasurement(bool enabled)
+{
+    measureOverdraw = enabled;
+}
+
+void PrismRenderer::setOcclusionCulling(bool enabled)
+{
+    if (enabled && !culler)
+        culler = new OcclusionCuller();
+    else if (!enabled && culler)
+    {
+        // The flags would otherwise still be read from the culler's buffer
+        for (size_t i = 0; i < batches.size(); i++)
+        {
+            glBindVertexArray(batches[i].mesh->VAO);
+            glDisableVertexAttribArray(INSTANCE_CULLED_LOCATION);
+        }
+        glBindVertexArray(0);
+        state.invalidate();
+
+        // Its calls leave the running total with it
+        callsCounted -= culler->stats().glCalls;
+        delete culler;
+        culler = NULL;
+    }
+}
+
+// Bounding sphere of an object from its world transform: radius 0.5 around the axis and 0.5 either side of the
+// centre, times the largest scale along any of its axes
+void PrismRenderer::updateBounds(uint32_t node)
+{
+    const AffineTransform &world = graph.world(node);
+    glm::vec3 axes[3];
+    for (int column = 0; column < 3; column++)
+        axes[column] = glm::vec3(world.rows[0][column], world.rows[1][column], world.rows[2][column]);
+
+    objects[node].centre = glm::vec3(world.rows[0].w, world.rows[1].w, world.rows[2].w);
+    objects[node].radius = 0.70710678f * std::max(glm::length(axes[0]), std::max(glm::length(axes[1]), glm::length(axes[2])));
+}
+
+void PrismRenderer::setSpin(float radians)
+{
+    // Kept within a turn, where the instance kernel's sine and cosine are accurate
+    spin = (float)fmod((double)radians, 2.0 * M_PI);
+}
+
+// Coarsest level of detail whose sides still come out no longer than LOD_SIDE_PIXELS, judged by the object's
+// bounding sphere of the given radius at clip-space w, in a view where a unit at w = 1 is pixelsPerUnit pixels
+// high; objects the camera is inside of get the finest level
+int PrismRenderer::selectLod(const SceneObject &object, float w, float radius, float pixelsPerUnit) const
+{
+    if (w <= radius)
+        return 0;
+
+    // A side is about 2 pi r / sides long, so the level needs at least this many sides
+    float radiusPixels = radius * pixelsPerUnit / w;
+    float sidesNeeded = 6.2831853f * radiusPixels / LOD_SIDE_PIXELS;
+
+    int lod = 0;
+    while (lod + 1 < object.lodCount && (float)batches[object.lods[lod + 1]].mesh->sides >= sidesNeeded)
+        lod++;
+    return lod;
+}
+
+// Depth buckets are spaced logarithmically from the near plane, so they are as fine close up as they need to be
+// and a handful covers the whole view
+static int depthBucket(float w)
+{
+    if (w <= DEPTH_BUCKET_NEAR)
+        return 0;
+
+    int bucket = (int)(log2f(w / DEPTH_BUCKET_NEAR) * DEPTH_BUCKETS_PER_OCTAVE);
+    return bucket < PrismRenderer::DEPTH_BUCKETS ? bucket : PrismRenderer::DEPTH_BUCKETS - 1;
+}
+
+// Planes of the frustum a clip-space transform maps to [-w, w], in the space it transforms from and normalised so
+// that they give distances there: left, right, bottom, top, near and far
+static void frustumPlanesOf(const glm::mat4 &clip, glm::vec4 *planes)
+{
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++)
+        rows[row] = glm::vec4(clip[0][row], clip[1][row], clip[2][row], clip[3][row]);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        planes[2 * axis] = rows[3] + rows[axis];
+        planes[2 * axis + 1] = rows[3] - rows[axis];
+    }
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// Whether a bounding sphere may reach into the frustum; spheres just outside a corner pass as well
+static bool sphereInFrustum(const glm::vec4 *planes, const glm::vec3 &centre, float radius)
+{
+    for (int i = 0; i < 6; i++)
+        if (glm::dot(glm::vec3(planes[i]), centre) + planes[i].w < -radius)
+            return false;
+    return true;
+}
+
+void PrismRenderer::draw(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection)
+{
+    RenderView whole = {view, projection, 0, 0, viewportWidth, viewportHeight};
+    drawViews(model, &whole, 1);
+}
+
+void PrismRenderer::drawViews(const glm::mat4 &model, const RenderView *views, int viewCount)
+{
+    // A new spin moves every prism: rebuild the local transforms and let the scene graph carry them down to the
+    // world transforms. Otherwise only nodes that were changed directly are recomputed, which is usually none.
+    if (spin != appliedSpin)
+    {
+        AffineTransform *locals = graph.localTransforms();
+        jobSystem->parallelFor(0, (int)objects.size(), INSTANCE_WRITE_GRAIN, [&](int begin, int end) {
+            transforms.writeLocals(spin, begin, end, locals);
+        });
+        graph.markAllDirty();
+        appliedSpin = spin;
+    }
+
+    changedNodes.clear();
+    if (graph.update(changedNodes) > 0)
+    {
+        jobSystem->parallelFor(0, (int)changedNodes.size(), SCENE_BOUNDS_GRAIN, [&](int begin, int end) {
+            for (int r = begin; r < end; r++)
+                for (uint32_t node = changedNodes[r].first; node < changedNodes[r].end; node++)
+                    updateBounds(node);
+        });
+    }
+
+    // Sort this frame's instances by the mesh their level of detail uses and by how far away they are. The views'
+    // cameras are rigid, so the model's scale is the same in all of them.
+    glm::mat4 modelView = views[0].view * model;
+    float modelScale = std::max(glm::length(glm::vec3(modelView[0])),
+                                std::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+
+    frustumPlanes.resize(6 * viewCount);
+    modelViews.resize(viewCount);
+    for (int v = 0; v < viewCount; v++)
+    {
+        modelViews[v] = views[v].view * model;
+        frustumPlanesOf(views[v].projection * modelViews[v], &frustumPlanes[6 * v]);
+    }
+
+    // Pick every object's mesh and depth bucket, and note how far away it is: the finest level any view that sees
+    // it needs, at its depth in the first of them. Objects no view sees are culled here.
+    size_t objectCount = objects.size();
+    objectCells.resize(objectCount);
+    objectDepths.resize(objectCount);
+    float nearest = 0.0f, farthest = 0.0f;
+    bool anyVisible = false;
+
+    for (size_t i = 0; i < objectCount; i++)
+    {
+        const SceneObject &object = objects[i];
+        int lod = MAX_LOD_LEVELS;
+        float depth = 0.0f;
+
+        for (int v = 0; v < viewCount; v++)
+        {
+            if (!sphereInFrustum(&frustumPlanes[6 * v], object.centre, object.radius))
+                continue;
+
+            const RenderView &view = views[v];
+            glm::vec4 centre = modelViews[v] * glm::vec4(object.centre, 1.0f);
+            float w = view.projection[0][3] * centre.x + view.projection[1][3] * centre.y + view.projection[2][3] * centre.z +
+                      view.projection[3][3];
+            if (lod == MAX_LOD_LEVELS)
+                depth = w;
+            lod = std::min(lod, selectLod(object, w, object.radius * modelScale, view.projection[1][1] * 0.5f * view.height));
+        }
+
+        if (lod == MAX_LOD_LEVELS)
+        {
+            objectCells[i] = CULLED_CELL;
+            continue;
+        }
+
+        objectCells[i] = (uint32_t)object.lods[lod] * DEPTH_BUCKETS + depthBucket(depth);
+        objectDepths[i] = depth;
+        nearest = !anyVisible || depth < nearest ? depth : nearest;
+        farthest = !anyVisible || depth > farthest ? depth : farthest;
+        anyVisible = true;
+    }
+
+    // Opaque geometry goes front to back, so that early depth testing rejects as much of what is hidden as it can:
+    // the objects are radix sorted on their depth quantized to 16 bits, and the instances of every draw are added
+    // in that order. In the scene order, the instances simply follow the scene file.
+    bool frontToBack = true;
+    int overdrawMode = -1;
+    if (measureOverdraw)
+    {
+        overdrawMode = (int)(overdrawFrames++ & 1);
+        frontToBack = overdrawMode == 0;
+    }
+
+    if (frontToBack)
+    {
+        float scale = farthest > nearest ? 65535.0f / (farthest - nearest) : 0.0f;
+        depthKeys.resize(objectCount);
+        for (size_t i = 0; i < objectCount; i++)
+            depthKeys[i] = objectCells[i] != CULLED_CELL ? (uint16_t)((objectDepths[i] - nearest) * scale) : 0xFFFF;
+
+        radixSortIndices(depthKeys.data(), objectCount, drawOrder, sortScratch);
+    }
+    else
+    {
+        drawOrder.resize(objectCount);
+        for (size_t i = 0; i < objectCount; i++)
+            drawOrder[i] = (uint32_t)i;
+    }
+
+    size_t cellCount = batches.size() * DEPTH_BUCKETS;
+    cellCounts.assign(cellCount, 0);
+    for (size_t i = 0; i < objectCount; i++)
+        if (objectCells[i] != CULLED_CELL)
+            cellCounts[objectCells[i]]++;
+
+    // Stream this frame's transforms, one block per view, and instances, and queue one draw per mesh and depth bucket
+    stream->beginFrame(viewCount * (uniformAlignment + sizeof(TransformBlock)) + cellCount * sizeof(InstanceData) +
+                       objectCount * sizeof(InstanceData));
+    transformsOffsets.resize(viewCount);
+    for (int v = 0; v < viewCount; v++)
+    {
+        TransformBlock *block = (TransformBlock *)stream->allocate(sizeof(TransformBlock), uniformAlignment, transformsOffsets[v]);
+        block->model = model;
+        block->view = views[v].view;
+        block->projection = views[v].projection;
+    }
+
+    queue.clear();
+    cellSlots.resize(cellCount);
+    for (size_t cell = 0; cell < cellCount; cell++)
+    {
+        if (cellCounts[cell] == 0)
+            continue;
+
+        DrawCommand command;
+        command.program = shaderProgram;
+        command.mesh = batches[cell / DEPTH_BUCKETS].mesh;
+        command.instanceCount = (GLsizei)cellCounts[cell];
+        cellSlots[cell] = (InstanceData *)stream->allocate(cellCounts[cell] * sizeof(InstanceData), sizeof(InstanceData),
+                                                           command.instanceOffset);
+
+        queue.push(drawSortKey(0, command.mesh->arena, (unsigned int)(cell % DEPTH_BUCKETS)), command);
+    }
+
+    // Every object's instance goes to the next slot of its draw, in draw order; they are then copied there from
+    // the scene graph, a chunk of objects per job
+    instanceSlots.resize(objectCount);
+    for (size_t i = 0; i < objectCount; i++)
+    {
+        uint32_t object = drawOrder[i];
+        instanceSlots[object] = objectCells[object] != CULLED_CELL ? cellSlots[objectCells[object]]++ : NULL;
+    }
+
+    jobSystem->parallelFor(0, (int)objectCount, INSTANCE_WRITE_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            InstanceData *instance = instanceSlots[i];
+            if (!instance)
+                continue;
+
+            const AffineTransform &world = graph.world((uint32_t)i);
+            instance->rows[0] = world.rows[0];
+            instance->rows[1] = world.rows[1];
+            instance->rows[2] = world.rows[2];
+            instance->seed = objects[i].seed;
+        }
+    });
+    stream->flush();
+    queue.sort();
+
+    // Time the frame on the GPU, culling included, while occlusion culling is on; every HIZ_REFERENCE_INTERVAL-th
+    // frame is drawn without culling to compare against. The pyramid holds one view's depth, so frames of several
+    // views leave it out, and the pyramid has to be built again once there is a single view.
+    int timingMode = -1;
+    bool cullThisFrame = false;
+    bool occlusion = culler && viewCount == 1;
+    if (culler && !occlusion)
+        culler->invalidate();
+    if (occlusion)
+    {
+        timingMode = cullingFrames++ % HIZ_REFERENCE_INTERVAL == HIZ_REFERENCE_INTERVAL - 1 ? 1 : 0;
+        cullThisFrame = timingMode == 0 && culler->ready();
+
+        // Take in every earlier frame whose timestamps have landed
+        GLuint64 stamps[2];
+        long long mode = 0;
+        while (frameTimers->read(stamps, &mode))
+        {
+            cullingTimes.frames[mode]++;
+            cullingTimes.gpuMs[mode] += (stamps[1] - stamps[0]) / 1e6;
+        }
+        frameTimers->stamp(0);
+    }
+
+    // Occlusion culling: every draw's instances are tested against the last frame's depth, and the draws then read
+    // a flag per instance from the culler's output next to their instance data. Nothing is read back, so the draws
+    // are queued right behind the culling without waiting for it.
+    if (cullThisFrame)
+    {
+        culler->beginFrame(objectCount);
+        culledOffsets.resize(queue.size());
+        for (size_t i = 0; i < queue.size(); i++)
+            culledOffsets[i] = culler->cull(stream->buffer(), queue[i].instanceOffset, queue[i].instanceCount);
+        culler->endFrame();
+    }
+
+    // Draw figures
+    frameDraws = FrameDrawStats();
+    state.invalidate();
+    state.bindArrayBuffer(stream->buffer());
+
+    // Where the flags are not enabled, every instance reads this value and is drawn
+    if (!cullThisFrame)
+    {
+        glVertexAttribI4ui(INSTANCE_CULLED_LOCATION, 0, 0, 0, 0);
+        state.countCalls(1);
+    }
+
+    // Count the fragments that pass the depth test, alternating between the two orders; a query is read back two
+    // frames after it was issued, by which time its result is normally there
+    if (overdrawMode >= 0)
+    {
+        if (overdrawPending[overdrawMode])
+        {
+            GLuint64 fragments = 0;
+            glGetQueryObjectui64v(overdrawQueries[overdrawMode], GL_QUERY_RESULT, &fragments);
+            state.countCalls(1);
+            overdraw.frames[overdrawMode]++;
+            overdraw.fragments[overdrawMode] += fragments;
+        }
+
+        glBeginQuery(GL_SAMPLES_PASSED, overdrawQueries[overdrawMode]);
+        state.countCalls(1);
+        overdrawPending[overdrawMode] = true;
+    }
+
+    // Every view draws the same draws with its own transforms, into its own viewport
+    for (int v = 0; v < viewCount; v++)
+    {
+        if (viewCount > 1)
+        {
+            glViewport(views[v].x, views[v].y, views[v].width, views[v].height);
+            state.countCalls(1);
+        }
+        state.bindUniformRange(stream->buffer(), transformsOffsets[v], sizeof(TransformBlock));
+
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            const DrawCommand &command = queue[i];
+            const GpuMesh *mesh = command.mesh;
+            GLintptr instanceOffset = command.instanceOffset;
+            GLsizei instanceCount = command.instanceCount;
+            if (instanceCount == 0)
+                continue;
+
+            state.useProgram(command.program);
+            state.bindVertexArray(mesh->VAO);
+            if (cullThisFrame)
+            {
+                glEnableVertexAttribArray(INSTANCE_CULLED_LOCATION);
+                state.bindArrayBuffer(culler->outputBuffer());
+                glVertexAttribIPointer(INSTANCE_CULLED_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)culledOffsets[i]);
+                state.bindArrayBuffer(stream->buffer());
+                state.countCalls(2);
+            }
+            else if (culler)
+            {
+                glDisableVertexAttribArray(INSTANCE_CULLED_LOCATION);
+                state.countCalls(1);
+            }
+            for (GLuint row = 0; row < 3; row++)
+                glVertexAttribPointer(INSTANCE_ROWS_LOCATION + row, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                      (void *)(instanceOffset + row * sizeof(glm::vec4)));
+            glVertexAttribIPointer(INSTANCE_SEED_LOCATION, 1, GL_UNSIGNED_INT, sizeof(InstanceData),
+                                   (void *)(instanceOffset + 3 * sizeof(glm::vec4)));
+
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT,
+                                              (void *)(mesh->firstIndex * sizeof(uint32_t)), instanceCount, mesh->baseVertex);
+            state.countCalls(5);
+
+            frameDraws.draws++;
+            frameDraws.instances += instanceCount;
+            frameDraws.triangles += (unsigned long long)(mesh->indexCount / 3) * instanceCount;
+        }
+    }
+
+    if (viewCount > 1)
+    {
+        glViewport(0, 0, viewportWidth, viewportHeight);
+        state.countCalls(1);
+    }
+
+    if (overdrawMode >= 0)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        state.countCalls(1);
+    }
+
+    // This frame's depth is what the next frame is culled against
+    if (occlusion)
+    {
+        culler->buildPyramid(viewportWidth, viewportHeight, views[0].projection * views[0].view * model);
+        frameTimers->stamp(1);
+        frameTimers->endFrame(cullThisFrame ? 0 : 1);
+    }
+
+    state.bindArrayBuffer(0);
+    stream->endFrame();
+
+    // Every call since the last frame was drawn, the clear and viewport included, as counted where it was made
+    unsigned long long calls = state.stats().calls + stream->stats().glCalls + frameTimers->glCalls() +
+                               (culler ? culler->stats().glCalls : 0);
+    frameDraws.glCalls = (unsigned int)(calls - callsCounted);
+    callsCounted = calls;
+}
+
+void PrismRenderer::clear()
+{
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    state.countCalls(2);
+}
+
+GLFWwindow *createHiddenContext(int width, int height)
+{
+    if (!glfwInit())
+        return NULL;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow *window = glfwCreateWindow(width, height, "Prism", NULL, NULL);
+    if (window == NULL)
+    {
+        glfwTerminate();
+        return NULL;
+    }
+
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return NULL;
+    }
+
+    glViewport(0, 0, width, height);
+    return window;
+}
+
+void destroyHiddenContext(GLFWwindow *window)
+{
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+void readFramebuffer(int width, int height, Image &image)
+{
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(4 * width * height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+}
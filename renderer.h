@@ -0,0 +1,237 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "gpu_timers.h"
+#include "image.h"
+#include "mesh_registry.h"
+#include "occlusion_culling.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "scene_graph.h"
+#include "stream_buffer.h"
+#include "transform_store.h"
+
+typedef struct GLFWwindow GLFWwindow;
+
+// Layout of the Transforms uniform block (std140), streamed once per frame
+struct TransformBlock
+{
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+// Per-object data streamed as instance attributes: the object-to-world transform as the rows of a 3x4 affine
+// matrix, and the seed its face colours are computed from
+struct InstanceData
+{
+    glm::vec4 rows[3];
+    uint32_t seed;
+    uint32_t padding[3];
+};
+
+// Fragments that passed the depth test while measuring overdraw, for frames drawn front to back ([0]) and frames
+// drawn in scene order ([1])
+struct OverdrawStats
+{
+    unsigned long long frames[2];
+    unsigned long long fragments[2];
+    unsigned long long pixels; // In the viewport
+};
+
+// GPU time of frames drawn with occlusion culling ([0], culling and building the pyramid included) and without ([1])
+struct CullingTimeStats
+{
+    unsigned long long frames[2];
+    double gpuMs[2];
+};
+
+// What the last frame drew: draws issued, the instances and triangles in them (after frustum culling; those the
+// occlusion culler flags are still submitted, then clipped away), and every GL call the renderer made for the frame,
+// from the clear through streaming, culling, queries, binds and attribute pointers to the draws themselves
+struct FrameDrawStats
+{
+    unsigned int draws;
+    unsigned long long instances;
+    unsigned long long triangles;
+    unsigned int glCalls;
+};
+
+// One of the cameras a frame is drawn from, and the part of the framebuffer it is drawn into
+struct RenderView
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    int x, y, width, height; // Viewport
+};
+
+// The prism camera's lens
+glm::mat4 prismProjection(float aspect);
+
+// Compile and link a program, printing any compile or link errors. A geometry shader and outputs to capture with
+// transform feedback (interleaved) are optional; without a fragment shader the program is only good for feedback.
+unsigned int buildShaderProgram(const char *vertexSource, const char *fragmentSource, const char *geometrySource = NULL,
+                                const char *const *feedbackVaryings = NULL, int feedbackVaryingCount = 0);
+
+// Hidden window with a GL 3.3 core context made current on the calling thread, for headless rendering;
+// returns NULL if no context could be created. destroyHiddenContext() also terminates GLFW.
+GLFWwindow *createHiddenContext(int width, int height);
+void destroyHiddenContext(GLFWwindow *window);
+
+// Read back the bottom-left width x height pixels of the current framebuffer
+void readFramebuffer(int width, int height, Image &image);
+
+// GL resources for drawing the prisms of a scene; must be created and used on the thread that owns the context.
+// Objects sharing a mesh are drawn together as one instanced draw, each at the level of detail its size on screen
+// calls for.
+class PrismRenderer
+{
+public:
+    static const int MAX_LOD_LEVELS = 8;
+    static const int DEPTH_BUCKETS = 16;
+    static const int FRAME_TIMER_COUNT = 4;
+
+    PrismRenderer(const Scene &scene, const char *meshCache);
+    ~PrismRenderer();
+
+    // Resize the viewport; its height is what levels of detail are picked against
+    void setViewport(int width, int height);
+
+    // Alternate frames between front-to-back and scene order and count the fragments each one shades
+    void setOverdrawMeasurement(bool enabled);
+
+    // Cull instances hidden behind what was drawn in the previous frame (see OcclusionCuller)
+    void setOcclusionCulling(bool enabled);
+
+    // Spin every prism about its own x axis by this many radians from its pose in the scene
+    void setSpin(float radians);
+
+    // Clear the bound framebuffer's colour and depth, at the start of a frame
+    void clear();
+
+    // Draw into the whole viewport
+    void draw(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection);
+
+    // Draw the scene once per view, each into its own viewport, from a single pass over the objects: they are culled
+    // against the union of the views' frusta and get the finest level of detail any view needs, and their instances
+    // are streamed once and drawn by every view with the same meshes and buffers. Occlusion culling only applies to
+    // frames of one view. The first view's depth decides the draw order.
+    void drawViews(const glm::mat4 &model, const RenderView *views, int viewCount);
+
+    const StreamBufferStats &streamStats() const
+    {
+        return stream->stats();
+    }
+
+    const MeshRegistry &meshes() const
+    {
+        return registry;
+    }
+
+    size_t objectCount() const
+    {
+        return objects.size();
+    }
+
+    // World transforms of the scene prisms as of the last frame drawn
+    const SceneGraph &sceneGraph() const
+    {
+        return graph;
+    }
+
+    const StateCacheStats &stateStats() const
+    {
+        return state.stats();
+    }
+
+    const OverdrawStats &overdrawStats() const
+    {
+        return overdraw;
+    }
+
+    // NULL while occlusion culling is off
+    const OcclusionStats *occlusionStats() const
+    {
+        return culler ? &culler->stats() : NULL;
+    }
+
+    const CullingTimeStats &cullingTimeStats() const
+    {
+        return cullingTimes;
+    }
+
+    const FrameDrawStats &frameDrawStats() const
+    {
+        return frameDraws;
+    }
+
+private:
+    // A scene prism, by scene graph node, and the meshes of its levels of detail, finest first, as indices into
+    // batches. Its centre and bounding radius follow its world transform.
+    struct SceneObject
+    {
+        glm::vec3 centre;
+        float radius;
+        uint32_t seed;
+        int lodCount;
+        int lods[MAX_LOD_LEVELS];
+    };
+
+    // Every object drawn with one mesh
+    struct Batch
+    {
+        GpuMesh *mesh;
+    };
+
+    void updateBounds(uint32_t node);
+    int selectLod(const SceneObject &object, float w, float radius, float pixelsPerUnit) const;
+
+    unsigned int shaderProgram;
+    GLint uniformAlignment;
+    int viewportWidth, viewportHeight;
+    StreamBuffer *stream;
+    MeshRegistry registry;
+    std::vector<SceneObject> objects;
+    SceneGraph graph;
+    TransformStore transforms;
+    float spin, appliedSpin;
+    std::vector<NodeRange> changedNodes;
+    std::vector<Batch> batches;
+    RenderQueue queue;
+    GLStateCache state;
+
+    // Per-frame scratch: the views' model-view matrices and frustum planes, each object's mesh and depth bucket (as
+    // a batch index * DEPTH_BUCKETS + bucket, or CULLED_CELL), its depth, the order objects are added to their draws
+    // in, how many instances every cell has and where in the stream buffer the next one goes, where each object's
+    // instance goes, and where each view's transforms are
+    std::vector<glm::mat4> modelViews;
+    std::vector<glm::vec4> frustumPlanes;
+    std::vector<uint32_t> objectCells;
+    std::vector<float> objectDepths;
+    std::vector<uint16_t> depthKeys;
+    std::vector<uint32_t> drawOrder;
+    std::vector<uint32_t> sortScratch;
+    std::vector<uint32_t> cellCounts;
+    std::vector<InstanceData *> cellSlots;
+    std::vector<InstanceData *> instanceSlots;
+    std::vector<GLintptr> transformsOffsets;
+
+    bool measureOverdraw;
+    unsigned long long overdrawFrames;
+    unsigned int overdrawQueries[2];
+    bool overdrawPending[2];
+    OverdrawStats overdraw;
+
+    OcclusionCuller *culler;
+    std::vector<GLintptr> culledOffsets; // Where each draw's flags start in the culler's output
+    unsigned long long cullingFrames;
+    GpuTimerRing *frameTimers; // Tagged with the CullingTimeStats slot of each frame
+    CullingTimeStats cullingTimes;
+    FrameDrawStats frameDraws;
+    unsigned long long callsCounted; // GL calls of the state cache, stream buffer, timers and culler up to the last frame
+};
+
+#endif
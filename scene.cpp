@@ -0,0 +1,448 @@
+#include "scene.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "mapped_file.h"
+
+// Bytes of text per parsing job; chunk boundaries are moved forward to the next line start
+const size_t SCENE_CHUNK_BYTES = 1 << 20;
+
+// Records per job when converting a binary scene, and prisms per job when baking the scene mesh
+const int SCENE_RECORD_GRAIN = 65536;
+const int SCENE_PRISM_GRAIN = 1024;
+
+// Powers of ten that are exact in double precision
+static const double EXACT_POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline void skipSpaces(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+}
+
+// A field has to be followed by whitespace, a comment or the end of the line
+static inline bool fieldEnds(const char *p, const char *end)
+{
+    return p == end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '#';
+}
+
+static bool parseUnsigned(const char *&p, const char *end, uint32_t &value)
+{
+    uint64_t result = 0;
+    const char *start = p;
+
+    while (p < end && isDigit(*p) && result <= 0xFFFFFFFFull)
+        result = result * 10 + (*p++ - '0');
+
+    if (p == start || result > 0xFFFFFFFFull || !fieldEnds(p, end))
+        return false;
+
+    value = (uint32_t)result;
+    return true;
+}
+
+// Decimal to float without strtof's locale handling: up to 19 significant digits are gathered into an integer,
+// which is exact in a double and only needs one multiply or divide by an exact power of ten for typical inputs.
+// The result is within an ulp of strtof.
+static bool parseFloat(const char *&p, const char *end, float &value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+
+    for (; p < end && isDigit(*p); p++, any = true)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+            exponent++;
+    }
+
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && isDigit(*p); p++, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (!any)
+        return false;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+        if (p == end || !isDigit(*p))
+            return false;
+
+        int written = 0;
+        for (; p < end && isDigit(*p); p++)
+            if (written < 10000)
+                written = written * 10 + (*p - '0');
+        exponent += negativeExponent ? -written : written;
+    }
+
+    if (!fieldEnds(p, end))
+        return false;
+
+    double result = (double)mantissa;
+    if (mantissa == 0)
+        result = 0.0;
+    else if (exponent >= 0 && exponent <= 22)
+        result *= EXACT_POWERS_OF_TEN[exponent];
+    else if (exponent < 0 && exponent >= -22)
+        result /= EXACT_POWERS_OF_TEN[-exponent];
+    else
+        result *= pow(10.0, exponent);
+
+    value = (float)(negative ? -result : result);
+    return true;
+}
+
+// Prisms and line count of one chunk of a text scene, plus its first error if it has one
+struct SceneChunk
+{
+    std::vector<ScenePrism> prisms;
+    int lines;
+    int errorLine; // Within the chunk, counting from 1; 0 if there was no error
+    const char *error;
+};
+
+// Returns NULL when the line held a prism (or nothing), an error message otherwise
+static const char *parseSceneLine(const char *p, const char *end, ScenePrism &prism, bool &empty)
+{
+    skipSpaces(p, end);
+    empty = p == end || *p == '#';
+    if (empty)
+        return NULL;
+
+    uint32_t n;
+    if (!parseUnsigned(p, end, n))
+        return "expected the number of sides";
+    if (n < 3)
+        return "a prism needs at least 3 sides";
+    if (n > 0x7FFFFFFF)
+        return "too many sides";
+    prism.n = (int)n;
+
+    float *fields[7] = {&prism.centre.x,   &prism.centre.y,   &prism.centre.z, &prism.rotation.x,
+                        &prism.rotation.y, &prism.rotation.z, &prism.scale};
+    for (int i = 0; i < 7; i++)
+    {
+        skipSpaces(p, end);
+        if (!parseFloat(p, end, *fields[i]))
+            return i < 3 ? "expected a centre coordinate" : i < 6 ? "expected a rotation angle" : "expected a scale";
+    }
+
+    skipSpaces(p, end);
+    if (!parseUnsigned(p, end, prism.seed))
+        return "expected a seed";
+
+    skipSpaces(p, end);
+    prism.parent = -1;
+    if (p != end && *p != '#')
+    {
+        uint32_t parent;
+        if (!parseUnsigned(p, end, parent) || parent > 0x7FFFFFFF)
+            return "expected a parent index after the seed";
+        prism.parent = (int)parent;
+
+        skipSpaces(p, end);
+        if (p != end && *p != '#')
+            return "unexpected text after the parent";
+    }
+
+    return NULL;
+}
+
+static void parseSceneChunk(const char *begin, const char *end, SceneChunk &chunk)
+{
+    chunk.lines = 0;
+    chunk.errorLine = 0;
+    chunk.error = NULL;
+
+    for (const char *line = begin; line < end;)
+    {
+        const char *lineEnd = (const char *)memchr(line, '\n', end - line);
+        if (!lineEnd)
+            lineEnd = end;
+        chunk.lines++;
+
+        ScenePrism prism;
+        bool empty;
+        const char *error = parseSceneLine(line, lineEnd, prism, empty);
+        if (error)
+        {
+            chunk.errorLine = chunk.lines;
+            chunk.error = error;
+            return;
+        }
+        if (!empty)
+            chunk.prisms.push_back(prism);
+
+        line = lineEnd + 1;
+    }
+}
+
+static bool loadTextScene(const char *path, const char *text, size_t size, Scene &scene, JobSystem &jobs)
+{
+    const char *end = text + size;
+
+    // Chunks start right after a newline, so every chunk starts on a whole line
+    std::vector<const char *> starts(1, text);
+    for (size_t offset = SCENE_CHUNK_BYTES; offset < size; offset += SCENE_CHUNK_BYTES)
+    {
+        const char *from = text + offset;
+        if (from <= starts.back())
+            continue;
+
+        const char *newline = (const char *)memchr(from, '\n', end - from);
+        if (!newline || newline + 1 >= end)
+            break;
+        starts.push_back(newline + 1);
+    }
+    starts.push_back(end);
+
+    int chunkCount = (int)starts.size() - 1;
+    std::vector<SceneChunk> chunks(chunkCount);
+    jobs.parallelFor(0, chunkCount, 1, [&](int begin, int last) {
+        for (int i = begin; i < last; i++)
+            parseSceneChunk(starts[i], starts[i + 1], chunks[i]);
+    });
+
+    // Line numbers and output positions follow from the chunks before
+    std::vector<size_t> firstPrism(chunkCount + 1, 0);
+    int linesBefore = 0;
+    for (int i = 0; i < chunkCount; i++)
+    {
+        if (chunks[i].error)
+        {
+            std::cout << path << ":" << linesBefore + chunks[i].errorLine << ": " << chunks[i].error << std::endl;
+            return false;
+        }
+
+        linesBefore += chunks[i].lines;
+        firstPrism[i + 1] = firstPrism[i] + chunks[i].prisms.size();
+    }
+
+    scene.prisms.resize(firstPrism[chunkCount]);
+    jobs.parallelFor(0, chunkCount, 1, [&](int begin, int last) {
+        for (int i = begin; i < last; i++)
+            if (!chunks[i].prisms.empty())
+                memcpy(&scene.prisms[firstPrism[i]], chunks[i].prisms.data(), chunks[i].prisms.size() * sizeof(ScenePrism));
+    });
+
+    return true;
+}
+
+static bool loadBinaryScene(const char *path, const unsigned char *data, size_t size, Scene &scene, JobSystem &jobs)
+{
+    SceneFileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    // Version 1 records are the same without the parent
+    size_t recordSize = header.version == 1 ? offsetof(SceneFileRecord, parent) : sizeof(SceneFileRecord);
+    if ((header.version != 1 && header.version != SCENE_FILE_VERSION) || size != sizeof(header) + (size_t)header.count * recordSize)
+    {
+        std::cout << path << ": unsupported version or truncated scene file" << std::endl;
+        return false;
+    }
+
+    const unsigned char *records = data + sizeof(header);
+    int firstInvalid = -1;
+    std::mutex invalidMutex;
+
+    scene.prisms.resize(header.count);
+    jobs.parallelFor(0, (int)header.count, SCENE_RECORD_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            SceneFileRecord record;
+            record.parent = -1;
+            memcpy(&record, records + i * recordSize, recordSize);
+
+            ScenePrism &prism = scene.prisms[i];
+            prism.n = (int)record.n;
+            prism.seed = record.seed;
+            prism.centre = glm::vec3(record.centre[0], record.centre[1], record.centre[2]);
+            prism.rotation = glm::vec3(record.rotation[0], record.rotation[1], record.rotation[2]);
+            prism.scale = record.scale;
+            prism.parent = record.parent;
+
+            if (record.n < 3 || record.n > 0x7FFFFFFF)
+            {
+                std::lock_guard<std::mutex> lock(invalidMutex);
+                if (firstInvalid < 0 || i < firstInvalid)
+                    firstInvalid = i;
+            }
+        }
+    });
+
+    if (firstInvalid >= 0)
+    {
+        std::cout << path << ": prism " << firstInvalid << " needs at least 3 sides" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool loadScene(const char *path, Scene &scene, JobSystem &jobs)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        std::cout << "Failed to open scene " << path << std::endl;
+        return false;
+    }
+
+    scene.prisms.clear();
+
+    uint32_t magic = 0;
+    if (file.size() >= sizeof(SceneFileHeader))
+        memcpy(&magic, file.data(), sizeof(magic));
+
+    bool loaded = magic == SCENE_FILE_MAGIC ? loadBinaryScene(path, file.data(), file.size(), scene, jobs)
+                                            : loadTextScene(path, (const char *)file.data(), file.size(), scene, jobs);
+    if (!loaded)
+        return false;
+
+    // Parents come first, which keeps the hierarchy free of cycles
+    for (size_t i = 0; i < scene.prisms.size(); i++)
+    {
+        if (scene.prisms[i].parent >= (int)i)
+        {
+            std::cout << path << ": prism " << i << " has parent " << scene.prisms[i].parent
+                      << ", which does not come before it" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool saveSceneBinary(const char *path, const Scene &scene)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    SceneFileHeader header = {SCENE_FILE_MAGIC, SCENE_FILE_VERSION, (uint32_t)scene.prisms.size(), 0};
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    std::vector<SceneFileRecord> records(scene.prisms.size());
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const ScenePrism &prism = scene.prisms[i];
+        SceneFileRecord &record = records[i];
+
+        record.n = prism.n;
+        record.seed = prism.seed;
+        for (int k = 0; k < 3; k++)
+        {
+            record.centre[k] = prism.centre[k];
+            record.rotation[k] = prism.rotation[k];
+        }
+        record.scale = prism.scale;
+        record.parent = prism.parent;
+    }
+
+    if (!records.empty())
+        written = written && fwrite(records.data(), sizeof(SceneFileRecord), records.size(), file) == records.size();
+
+    return fclose(file) == 0 && written;
+}
+
+void singlePrismScene(int n, uint32_t seed, glm::vec3 centre, Scene &scene)
+{
+    ScenePrism prism = {n, seed, centre, glm::vec3(0.0f), 1.0f, -1};
+    scene.prisms.assign(1, prism);
+}
+
+glm::mat4 scenePrismTransform(const ScenePrism &prism)
+{
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), prism.centre);
+    transform = glm::rotate(transform, glm::radians(prism.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    transform = glm::rotate(transform, glm::radians(prism.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(prism.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    return glm::scale(transform, glm::vec3(prism.scale));
+}
+
+void sceneWorldTransforms(const Scene &scene, std::vector<glm::mat4> &transforms)
+{
+    transforms.resize(scene.prisms.size());
+    for (size_t i = 0; i < scene.prisms.size(); i++)
+    {
+        const ScenePrism &prism = scene.prisms[i];
+        transforms[i] = scenePrismTransform(prism);
+        if (prism.parent >= 0)
+            transforms[i] = transforms[prism.parent] * transforms[i];
+    }
+}
+
+void buildSceneMesh(const Scene &scene, PrismMesh &mesh, JobSystem &jobs)
+{
+    int count = (int)scene.prisms.size();
+
+    // Where each prism's vertices, indices and face colours start
+    std::vector<size_t> firstVertex(count + 1, 0), firstIndex(count + 1, 0), firstFace(count + 1, 0);
+    for (int i = 0; i < count; i++)
+    {
+        int n = scene.prisms[i].n;
+        firstVertex[i + 1] = firstVertex[i] + prismVertexCount(n);
+        firstIndex[i + 1] = firstIndex[i] + prismIndexCount(n);
+        firstFace[i + 1] = firstFace[i] + n + 2;
+    }
+
+    mesh.vertices.resize(6 * firstVertex[count]);
+    mesh.indices.resize(firstIndex[count]);
+    mesh.faceColors.resize(3 * firstFace[count]);
+
+    std::vector<glm::mat4> transforms;
+    sceneWorldTransforms(scene, transforms);
+
+    jobs.parallelFor(0, count, SCENE_PRISM_GRAIN, [&](int begin, int end) {
+        for (int i = begin; i < end; i++)
+        {
+            const ScenePrism &prism = scene.prisms[i];
+            float *vertices = &mesh.vertices[6 * firstVertex[i]];
+
+            writePrism(prism.n, prism.seed, (uint32_t)firstVertex[i], vertices, &mesh.indices[firstIndex[i]],
+                       &mesh.faceColors[3 * firstFace[i]]);
+
+            // Into world space
+            const glm::mat4 &transform = transforms[i];
+            for (int v = 0; v < prismVertexCount(prism.n); v++)
+            {
+                float *position = &vertices[6 * v];
+                glm::vec4 world = transform * glm::vec4(position[0], position[1], position[2], 1.0f);
+                position[0] = world.x;
+                position[1] = world.y;
+                position[2] = world.z;
+            }
+        }
+    });
+}
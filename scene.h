@@ -0,0 +1,69 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "job_system.h"
+#include "prism.h"
+
+// One prism placed in a scene. Rotation is in degrees about x, then y, then z; scale is uniform. A prism with a
+// parent is placed in the parent's object space, and moves with it.
+struct ScenePrism
+{
+    int n;
+    uint32_t seed;
+    glm::vec3 centre;
+    glm::vec3 rotation;
+    float scale;
+    int parent; // Index of the parent prism, which comes earlier in the scene; -1 for none
+};
+
+struct Scene
+{
+    std::vector<ScenePrism> prisms;
+};
+
+// Scene files
+// -----------
+// Text: one prism per line, "<n> <cx> <cy> <cz> <rx> <ry> <rz> <scale> <seed> [parent]", where parent is the
+// index of an earlier prism; blank lines and anything after a '#' are ignored. Binary: a SceneFileHeader followed by
+// that many SceneFileRecords, all little-endian; version 1 records end before the parent and have none.
+// Either is mapped and the text form is parsed in parallel chunks. Errors are printed with their line number.
+const uint32_t SCENE_FILE_MAGIC = 0x4E435350; // "PSCN"
+const uint32_t SCENE_FILE_VERSION = 2;
+
+struct SceneFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct SceneFileRecord
+{
+    uint32_t n;
+    uint32_t seed;
+    float centre[3];
+    float rotation[3];
+    float scale;
+    int32_t parent;
+};
+
+// Scene of one upright prism of unit scale
+void singlePrismScene(int n, uint32_t seed, glm::vec3 centre, Scene &scene);
+
+bool loadScene(const char *path, Scene &scene, JobSystem &jobs);
+bool saveSceneBinary(const char *path, const Scene &scene);
+
+// Object-to-parent matrix of a scene prism; the object-to-world matrix for prisms without a parent
+glm::mat4 scenePrismTransform(const ScenePrism &prism);
+
+// Object-to-world matrix of every scene prism, parents applied
+void sceneWorldTransforms(const Scene &scene, std::vector<glm::mat4> &transforms);
+
+// Every prism of the scene baked into one world-space mesh, with each prism's faces in its own colours
+void buildSceneMesh(const Scene &scene, PrismMesh &mesh, JobSystem &jobs);
+
+#endif
@@ -0,0 +1,150 @@
+#include "scene_graph.h"
+#include <algorithm>
+
+// Dirty subtrees recomputed per job; a job's subtrees are independent of the others'
+const int SCENE_GRAPH_RANGE_GRAIN = 1024;
+
+AffineTransform affineTransform(const glm::mat4 &matrix)
+{
+    AffineTransform transform;
+    for (int row = 0; row < 3; row++)
+        transform.rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+    return transform;
+}
+
+AffineTransform operator*(const AffineTransform &a, const AffineTransform &b)
+{
+    AffineTransform result;
+    for (int row = 0; row < 3; row++)
+    {
+        const glm::vec4 &r = a.rows[row];
+        result.rows[row] = r.x * b.rows[0] + r.y * b.rows[1] + r.z * b.rows[2] + glm::vec4(0.0f, 0.0f, 0.0f, r.w);
+    }
+    return result;
+}
+
+SceneGraph::SceneGraph() : updates(0)
+{
+}
+
+void SceneGraph::build(const Scene &scene)
+{
+    size_t count = scene.prisms.size();
+
+    // Children of every prism, as a linked list through firstChild / nextSibling, in scene order
+    std::vector<int> firstChild(count, -1), nextSibling(count, -1), lastChild(count, -1);
+    std::vector<uint32_t> rootPrisms;
+    for (size_t i = 0; i < count; i++)
+    {
+        int parent = scene.prisms[i].parent;
+        if (parent < 0)
+        {
+            rootPrisms.push_back((uint32_t)i);
+            continue;
+        }
+
+        if (lastChild[parent] < 0)
+            firstChild[parent] = (int)i;
+        else
+            nextSibling[lastChild[parent]] = (int)i;
+        lastChild[parent] = (int)i;
+    }
+
+    // Depth-first order, with an explicit stack so that deep chains do not overflow the call stack
+    parents.resize(count);
+    subtreeEnds.resize(count);
+    nodes.resize(count);
+    prisms.resize(count);
+    roots.clear();
+
+    uint32_t next = 0;
+    std::vector<int> stack;
+    for (size_t r = 0; r < rootPrisms.size(); r++)
+    {
+        roots.push_back(next);
+        stack.push_back((int)rootPrisms[r]);
+
+        while (!stack.empty())
+        {
+            int prism = stack.back();
+            stack.pop_back();
+
+            uint32_t node = next++;
+            nodes[prism] = node;
+            prisms[node] = (uint32_t)prism;
+            parents[node] = scene.prisms[prism].parent < 0 ? -1 : (int)nodes[scene.prisms[prism].parent];
+
+            // Pushed in reverse so that children come out in scene order
+            std::vector<int>::size_type first = stack.size();
+            for (int child = firstChild[prism]; child >= 0; child = nextSibling[child])
+                stack.push_back(child);
+            std::reverse(stack.begin() + first, stack.end());
+        }
+    }
+
+    // A subtree ends where the next node that is not a descendant starts; children finish before their parents
+    // when walked backwards
+    for (size_t node = count; node-- > 0;)
+        subtreeEnds[node] = (uint32_t)node + 1;
+    for (size_t node = count; node-- > 0;)
+        if (parents[node] >= 0)
+            subtreeEnds[parents[node]] = std::max(subtreeEnds[parents[node]], subtreeEnds[node]);
+
+    locals.resize(count);
+    worlds.resize(count);
+    for (size_t node = 0; node < count; node++)
+        locals[node] = affineTransform(scenePrismTransform(scene.prisms[prisms[node]]));
+
+    dirty.assign(count, 0);
+    dirtyNodes.clear();
+    markAllDirty();
+
+    std::vector<NodeRange> changed;
+    update(changed);
+    updates = 0;
+}
+
+void SceneGraph::markAllDirty()
+{
+    for (size_t i = 0; i < roots.size(); i++)
+        markDirty(roots[i]);
+}
+
+size_t SceneGraph::update(std::vector<NodeRange> &changed)
+{
+    if (dirtyNodes.empty())
+        return 0;
+
+    // In node order, a dirty node inside a subtree already being recomputed adds nothing
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    size_t first = changed.size();
+    uint32_t coveredEnd = 0;
+    size_t recomputed = 0;
+
+    for (size_t i = 0; i < dirtyNodes.size(); i++)
+    {
+        uint32_t node = dirtyNodes[i];
+        dirty[node] = 0;
+        if (node < coveredEnd)
+            continue;
+
+        NodeRange range = {node, subtreeEnds[node]};
+        changed.push_back(range);
+        recomputed += range.end - range.first;
+        coveredEnd = range.end;
+    }
+    dirtyNodes.clear();
+
+    // Within a range every parent comes before its children, and everything outside it is up to date
+    NodeRange *ranges = &changed[first];
+    jobSystem->parallelFor(0, (int)(changed.size() - first), SCENE_GRAPH_RANGE_GRAIN, [&](int begin, int end) {
+        for (int r = begin; r < end; r++)
+        {
+            for (uint32_t node = ranges[r].first; node < ranges[r].end; node++)
+                worlds[node] = parents[node] < 0 ? locals[node] : worlds[parents[node]] * locals[node];
+        }
+    });
+
+    updates++;
+    return recomputed;
+}
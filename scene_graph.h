@@ -0,0 +1,122 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "scene.h"
+
+// 3x4 affine transform, as the rows of the matrix
+struct AffineTransform
+{
+    glm::vec4 rows[3];
+};
+
+AffineTransform affineTransform(const glm::mat4 &matrix);
+
+// a * b, as 4x4 matrices with (0, 0, 0, 1) for the missing row
+AffineTransform operator*(const AffineTransform &a, const AffineTransform &b);
+
+// Nodes [first, end) of a SceneGraph
+struct NodeRange
+{
+    uint32_t first, end;
+};
+
+// Scene graph
+// -----------
+// One node per scene prism, kept in flat arrays in depth-first order: every node comes after its parent, and its
+// descendants follow it up to subtreeEnd(). Each node holds its local transform (to its parent) and a cached world
+// transform. Changing a local transform sets the node's dirty bit; update() then recomputes the world transforms
+// of the dirty nodes' subtrees only, so a frame in which nothing moved costs nothing.
+class SceneGraph
+{
+public:
+    SceneGraph();
+
+    // Local transforms are the scene prisms' scenePrismTransform(); world transforms are computed right away
+    void build(const Scene &scene);
+
+    size_t size() const
+    {
+        return parents.size();
+    }
+
+    uint32_t nodeOfPrism(uint32_t prism) const
+    {
+        return nodes[prism];
+    }
+
+    uint32_t prismOfNode(uint32_t node) const
+    {
+        return prisms[node];
+    }
+
+    // Parent node, -1 for a root
+    int parent(uint32_t node) const
+    {
+        return parents[node];
+    }
+
+    uint32_t subtreeEnd(uint32_t node) const
+    {
+        return subtreeEnds[node];
+    }
+
+    const AffineTransform &local(uint32_t node) const
+    {
+        return locals[node];
+    }
+
+    const AffineTransform &world(uint32_t node) const
+    {
+        return worlds[node];
+    }
+
+    void setLocal(uint32_t node, const AffineTransform &transform)
+    {
+        locals[node] = transform;
+        markDirty(node);
+    }
+
+    // Local transforms for writing many at once, followed by markDirty() on the nodes written or markAllDirty()
+    AffineTransform *localTransforms()
+    {
+        return locals.data();
+    }
+
+    void markDirty(uint32_t node)
+    {
+        if (!dirty[node])
+        {
+            dirty[node] = 1;
+            dirtyNodes.push_back(node);
+        }
+    }
+
+    void markAllDirty();
+
+    // Recompute the world transforms of every dirty node and its descendants, and append the node ranges that were
+    // recomputed to changed; returns how many nodes that was
+    size_t update(std::vector<NodeRange> &changed);
+
+    // Bumped by every update() that recomputes anything
+    unsigned long long version() const
+    {
+        return updates;
+    }
+
+private:
+    std::vector<int> parents;
+    std::vector<uint32_t> subtreeEnds;
+    std::vector<uint32_t> nodes;  // By prism
+    std::vector<uint32_t> prisms; // By node
+    std::vector<uint32_t> roots;
+    std::vector<AffineTransform> locals;
+    std::vector<AffineTransform> worlds;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> dirtyNodes;
+    unsigned long long updates;
+};
+
+#endif
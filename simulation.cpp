@@ -0,0 +1,499 @@
+#include "simulation.h"
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <thread>
+
+void processInput();
+void processToggles();
+void reset();
+void startTurntable();
+
+// Settings
+const int SIMULATION_TICK_RATE = 60;
+
+// In low-latency mode, ticks are moved to this long before the render thread's next frame
+const std::chrono::microseconds INPUT_SAMPLE_LEAD(1000);
+bool OBJECT_SET_TO_ROTATE = false;
+bool CAMERA_SET_TO_REVOLVE = false;
+bool PREVIOUS_WAS_TRANSLATE = false;
+bool PRISMS_SPIN_IN_PLACE = false;
+bool SPLIT_SCREEN = false;
+
+// Set whenever the camera, the model or a toggle changes; a clean scene with no animation running is not republished
+bool SCENE_DIRTY = true;
+
+glm::mat4 model = glm::mat4(1.0f);
+glm::mat4 view;
+glm::vec3 origin = glm::vec3(0.0f, 0.0f, 0.0f);
+glm::vec3 c = glm::vec3(0.0f, 0.0f, 0.0f);
+glm::vec3 cameraPos = glm::vec3(c.x, c.y, c.z + 3.0f);
+glm::vec3 cameraTarget = glm::vec3(c.x, c.y, c.z);
+glm::vec3 cameraFront = cameraTarget - cameraPos;
+glm::vec3 cameraUp = glm::vec3(c.x, c.y + 1.0f, c.z);
+glm::mat4 identity = glm::mat4(1.0f);
+float angle = 0.0f;
+
+// Keys that act for as long as they are held; the simulation keeps ticking while any of them is down
+const int MOVEMENT_KEYS[] = {GLFW_KEY_Q, GLFW_KEY_E, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_M,
+                             GLFW_KEY_B, GLFW_KEY_J, GLFW_KEY_N, GLFW_KEY_H, GLFW_KEY_K, GLFW_KEY_1, GLFW_KEY_2};
+
+// Camera positions for the 1 and 2 keys
+const glm::vec3 PRESET_POSITIONS[2] = {glm::vec3(1.0f, 2.0f, 3.0f), glm::vec3(3.0f, 2.0f, 1.0f)};
+
+// Split screen's turntable circles the target at the start position's distance, and has been running this many ticks
+const float SPLIT_TURNTABLE_RADIUS = 3.0f;
+float splitTurntableFrame = 0.0f;
+
+// Turntable orbit around cameraTarget, parameterised by angle so that any frame can be evaluated directly
+struct Turntable
+{
+    glm::vec3 centre;
+    float radius;
+    float height;
+    float phase;
+    float angularStep; // Radians per frame
+    float frame;       // Frames elapsed since the orbit was started
+    glm::vec3 position;
+};
+Turntable turntable;
+
+TripleBuffer<FrameSnapshot> frameSnapshots;
+WakeEvent inputEvent;
+WakeEvent frameEvent;
+std::atomic<bool> QUIT_REQUESTED(false);
+
+// Key state shared with the GLFW thread: held flags for movement, press counters for toggles, and when each key
+// was last pressed if no tick has reacted to that press yet
+std::atomic<bool> keyDown[GLFW_KEY_LAST + 1];
+std::atomic<unsigned int> keyPresses[GLFW_KEY_LAST + 1];
+std::atomic<long long> keyPressTimes[GLFW_KEY_LAST + 1];
+unsigned int keyPressesSeen[GLFW_KEY_LAST + 1];
+
+// Input latency: the oldest press the current tick reacted to, and the press being carried in every published
+// snapshot until the render thread has drawn one of them
+long long tickInputTime = 0;
+long long carriedInputTime = 0;
+std::atomic<long long> inputTimeShown(0);
+std::atomic<long long> nextFrameStart(0);
+
+long long inputTimestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Called from the GLFW key callback on the main thread
+void recordKeyEvent(int key, int action)
+{
+    if (key < 0 || key > GLFW_KEY_LAST)
+        return;
+
+    if (action == GLFW_PRESS)
+    {
+        keyPressTimes[key].store(inputTimestamp(), std::memory_order_relaxed);
+        keyDown[key].store(true, std::memory_order_release);
+        keyPresses[key].fetch_add(1, std::memory_order_release);
+    }
+    else if (action == GLFW_RELEASE)
+        keyDown[key].store(false, std::memory_order_relaxed);
+
+    inputEvent.notify();
+}
+
+// The tick is reacting to the key: its press, if not reacted to before, is what the tick's effect is timed from
+void carryKeyPressTime(int key)
+{
+    long long pressed = keyPressTimes[key].exchange(0, std::memory_order_relaxed);
+    if (pressed != 0 && (tickInputTime == 0 || pressed < tickInputTime))
+        tickInputTime = pressed;
+}
+
+bool keyHeld(int key)
+{
+    if (!keyDown[key].load(std::memory_order_acquire))
+        return false;
+
+    carryKeyPressTime(key);
+    return true;
+}
+
+bool movementKeyDown()
+{
+    for (size_t i = 0; i < sizeof(MOVEMENT_KEYS) / sizeof(MOVEMENT_KEYS[0]); i++)
+        if (keyDown[MOVEMENT_KEYS[i]].load(std::memory_order_relaxed))
+            return true;
+    return false;
+}
+
+// Consume one press of the key that the simulation has not reacted to yet
+bool takeKeyPress(int key)
+{
+    if (keyPressesSeen[key] == keyPresses[key].load(std::memory_order_acquire))
+        return false;
+
+    keyPressesSeen[key]++;
+    carryKeyPressTime(key);
+    return true;
+}
+
+// Advance the scene by one tick; returns whether anything visible changed
+bool simulateTick()
+{
+    processToggles();
+
+    if (OBJECT_SET_TO_ROTATE)
+    {
+        angle += 0.05f;
+        SCENE_DIRTY = true;
+    }
+
+    model = glm::translate(identity, c);
+    if (!PRISMS_SPIN_IN_PLACE)
+        model = glm::rotate(model, angle, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    if (SPLIT_SCREEN)
+    {
+        splitTurntableFrame += 1.0f;
+        SCENE_DIRTY = true;
+    }
+
+    if (CAMERA_SET_TO_REVOLVE)
+    {
+        // The camera was moved off the orbit since the last tick, so carry on revolving from where it is now
+        if (cameraPos != turntable.position || cameraTarget != turntable.centre)
+            startTurntable();
+
+        turntable.frame += 1.0f;
+        cameraPos = turntable.position = turntablePosition(turntable.frame);
+        SCENE_DIRTY = true;
+    }
+
+    // Input
+    // -----
+    processInput();
+
+    if (!PREVIOUS_WAS_TRANSLATE)
+        view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
+
+    bool changed = SCENE_DIRTY;
+    SCENE_DIRTY = false;
+    return changed;
+}
+
+// Copy the current scene state into a snapshot
+void captureSnapshot(FrameSnapshot &snapshot)
+{
+    snapshot.model = model;
+    snapshot.view = view;
+    snapshot.spin = PRISMS_SPIN_IN_PLACE ? angle : 0.0f;
+    snapshot.inputTime = 0;
+
+    snapshot.splitScreen = SPLIT_SCREEN;
+    if (SPLIT_SCREEN)
+    {
+        // Same speed along the orbit as the turntable's
+        float theta = 0.05f / SPLIT_TURNTABLE_RADIUS * splitTurntableFrame;
+        glm::vec3 orbit = cameraTarget + SPLIT_TURNTABLE_RADIUS * glm::vec3(sin(theta), 0.0f, cos(theta));
+
+        snapshot.splitViews[0] = view;
+        snapshot.splitViews[1] = glm::lookAt(PRESET_POSITIONS[0], cameraTarget, cameraUp);
+        snapshot.splitViews[2] = glm::lookAt(PRESET_POSITIONS[1], cameraTarget, cameraUp);
+        snapshot.splitViews[3] = glm::lookAt(orbit, cameraTarget, cameraUp);
+    }
+}
+
+// Put the scene into one of the scripted camera configurations and capture it, without running the simulation
+// loop; only valid while the simulation thread is not running. The rotation is accumulated tick by tick exactly as
+// simulateTick() does, so frame k matches what the live program shows after k ticks of R.
+void scriptedSnapshot(CameraScript script, int frame, FrameSnapshot &snapshot)
+{
+    OBJECT_SET_TO_ROTATE = false;
+    CAMERA_SET_TO_REVOLVE = false;
+    PREVIOUS_WAS_TRANSLATE = false;
+    SPLIT_SCREEN = false;
+    cameraPos = glm::vec3(c.x, c.y, c.z + 3.0f);
+    cameraTarget = c;
+    cameraUp = glm::vec3(c.x, c.y + 1.0f, c.z);
+    angle = 0.0f;
+
+    if (script == CAMERA_PRESET_1 || script == CAMERA_PRESET_2)
+        cameraPos = PRESET_POSITIONS[script == CAMERA_PRESET_1 ? 0 : 1];
+    else if (script == CAMERA_TURNTABLE)
+    {
+        startTurntable();
+        turntable.frame = (float)frame;
+        cameraPos = turntable.position = turntablePosition(turntable.frame);
+    }
+    else if (script == CAMERA_ROTATED)
+    {
+        for (int i = 0; i < frame; i++)
+            angle += 0.05f;
+    }
+
+    model = glm::translate(identity, c);
+    if (!PRISMS_SPIN_IN_PLACE)
+        model = glm::rotate(model, angle, glm::vec3(1.0f, 0.0f, 0.0f));
+    view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
+
+    captureSnapshot(snapshot);
+    snapshot.tick = frame;
+}
+
+// Simulation thread: runs the scene at a fixed tick rate and publishes a snapshot whenever it changes
+// ---------------------------------------------------------------------------------------------------
+void simulationLoop()
+{
+    const std::chrono::nanoseconds tickLength(1000000000 / SIMULATION_TICK_RATE);
+    std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+    unsigned long long tick = 0;
+
+    while (!QUIT_REQUESTED.load())
+    {
+        bool changed = simulateTick();
+
+        // A press goes out with every snapshot until one of them has been drawn, so it is timed to the first frame
+        // on screen that shows it even if the render thread skips snapshots; presses that come while an earlier one
+        // is still out are not timed
+        if (carriedInputTime != 0 && inputTimeShown.load(std::memory_order_relaxed) == carriedInputTime)
+            carriedInputTime = 0;
+        if (carriedInputTime == 0)
+            carriedInputTime = tickInputTime;
+        tickInputTime = 0;
+
+        if (changed)
+        {
+            FrameSnapshot &snapshot = frameSnapshots.writeBuffer();
+            captureSnapshot(snapshot);
+            snapshot.tick = tick;
+            snapshot.inputTime = carriedInputTime;
+            frameSnapshots.publish();
+            frameEvent.notify();
+        }
+        tick++;
+
+        // Nothing is animating and no key is held, so only new input can change the next tick. A held key keeps
+        // the ticks coming at the full rate rather than at the rate the OS repeats it.
+        if (!changed && !OBJECT_SET_TO_ROTATE && !CAMERA_SET_TO_REVOLVE && !SPLIT_SCREEN && !movementKeyDown())
+        {
+            inputEvent.wait();
+            nextTick = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        nextTick += tickLength;
+
+        // When the render thread says when its next frame starts, sample input just before it, as long as that is
+        // within a tick of the regular schedule; the schedule itself stays put, so the tick rate does not change
+        std::chrono::steady_clock::time_point wake = nextTick;
+        long long frameStart = nextFrameStart.load(std::memory_order_relaxed);
+        if (frameStart != 0)
+        {
+            std::chrono::steady_clock::time_point sample(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(frameStart) - INPUT_SAMPLE_LEAD));
+            if (sample > nextTick && sample < nextTick + tickLength)
+                wake = sample;
+        }
+        std::this_thread::sleep_until(wake);
+    }
+}
+
+// Start a turntable orbit through the current camera position, about the vertical axis through the target
+void startTurntable()
+{
+    glm::vec3 offset = cameraPos - cameraTarget;
+
+    turntable.centre = cameraTarget;
+    turntable.radius = sqrt(offset.x * offset.x + offset.z * offset.z);
+    turntable.height = offset.y;
+    turntable.phase = atan2(offset.x, offset.z);
+    // Same speed along the orbit as the old fixed 0.05 step to the camera's right
+    turntable.angularStep = turntable.radius > 0.0f ? 0.05f / turntable.radius : 0.0f;
+    turntable.frame = 0.0f;
+    turntable.position = cameraPos;
+}
+
+// Camera position on the turntable orbit after the given number of frames
+glm::vec3 turntablePosition(float frame)
+{
+    float theta = turntable.phase + turntable.angularStep * frame;
+
+    return turntable.centre + glm::vec3(turntable.radius * sin(theta), turntable.height, turntable.radius * cos(theta));
+}
+
+// Snap camera back to centre of prism
+void reset()
+{
+    cameraTarget = c;
+}
+
+// Process all input: check which of the relevant keys are held down this tick and react accordingly
+// -------------------------------------------------------------------------------------------------
+void processInput()
+{
+    const float cameraSpeed = 0.05f;
+
+    // Part B - 1
+    if (keyHeld(GLFW_KEY_Q))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos += cameraSpeed * glm::vec3(0.0f, 1.0f, 0.0f);
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_E))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos -= cameraSpeed * glm::vec3(0.0f, 1.0f, 0.0f);
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_A))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos -= cameraSpeed * glm::vec3(1.0f, 0.0f, 0.0f);
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_D))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos += cameraSpeed * glm::vec3(1.0f, 0.0f, 0.0f);
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_W))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos += cameraSpeed * glm::vec3(0.0f, 0.0f, 1.0f);
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_S))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos -= cameraSpeed * glm::vec3(0.0f, 0.0f, 1.0f);
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+
+    // Part B - 2
+    if (keyHeld(GLFW_KEY_M))
+    {
+        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
+
+        model = glm::translate(model, 0.05f * currentRight);
+        c += 0.05f * currentRight;
+        PREVIOUS_WAS_TRANSLATE = true;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_B))
+    {
+        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
+
+        model = glm::translate(model, -0.05f * currentRight);
+        c -= 0.05f * currentRight;
+        PREVIOUS_WAS_TRANSLATE = true;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_J))
+    {
+        model = glm::translate(model, 0.05f * (cameraTarget - cameraPos));
+        c += 0.05f * (cameraTarget - cameraPos);
+        PREVIOUS_WAS_TRANSLATE = true;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_N))
+    {
+        model = glm::translate(model, -0.05f * (cameraTarget - cameraPos));
+        c -= 0.05f * (cameraTarget - cameraPos);
+        PREVIOUS_WAS_TRANSLATE = true;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_H))
+    {
+        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
+        glm::vec3 currentUp = glm::normalize(glm::cross(currentRight, cameraTarget - cameraPos));
+
+        model = glm::translate(model, 0.05f * currentUp);
+        c += 0.05f * currentUp;
+        PREVIOUS_WAS_TRANSLATE = true;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_K))
+    {
+        glm::vec3 currentRight = glm::normalize(glm::cross(cameraTarget - cameraPos, cameraUp));
+        glm::vec3 currentUp = glm::normalize(glm::cross(currentRight, cameraTarget - cameraPos));
+
+        model = glm::translate(model, -0.05f * currentUp);
+        c -= 0.05f * currentUp;
+        PREVIOUS_WAS_TRANSLATE = true;
+        SCENE_DIRTY = true;
+    }
+
+    // Part B - 3
+    if (keyHeld(GLFW_KEY_1))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos = PRESET_POSITIONS[0];
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+    if (keyHeld(GLFW_KEY_2))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        cameraPos = PRESET_POSITIONS[1];
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+}
+
+// Part B - 4 and 5
+void processToggles()
+{
+    while (takeKeyPress(GLFW_KEY_R))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        OBJECT_SET_TO_ROTATE = !OBJECT_SET_TO_ROTATE;
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+
+    while (takeKeyPress(GLFW_KEY_T))
+    {
+        if (PREVIOUS_WAS_TRANSLATE)
+            reset();
+
+        CAMERA_SET_TO_REVOLVE = !CAMERA_SET_TO_REVOLVE;
+        if (CAMERA_SET_TO_REVOLVE)
+            startTurntable();
+        PREVIOUS_WAS_TRANSLATE = false;
+        SCENE_DIRTY = true;
+    }
+
+    // Split screen
+    while (takeKeyPress(GLFW_KEY_V))
+    {
+        SPLIT_SCREEN = !SPLIT_SCREEN;
+        splitTurntableFrame = 0.0f;
+        SCENE_DIRTY = true;
+    }
+}
+
@@ -0,0 +1,53 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include "threading.h"
+
+// Split screen (V) shows the free camera, the cameras of the 1 and 2 presets and a turntable side by side
+const int SPLIT_VIEW_COUNT = 4;
+
+// Immutable description of one frame, produced by the simulation thread and consumed by the render thread
+struct FrameSnapshot
+{
+    glm::mat4 model;
+    glm::mat4 view;
+    bool splitScreen;
+    glm::mat4 splitViews[SPLIT_VIEW_COUNT]; // In split screen only; the first is view
+    float spin; // Radians every scene prism is turned about its own x axis, when they spin in place
+    unsigned long long tick;
+    long long inputTime; // inputTimestamp() of the key press this frame is the first to show, 0 for none
+};
+
+// Fixed camera configurations that can be reproduced without input, for regression renders
+enum CameraScript
+{
+    CAMERA_START,     // Where the program starts
+    CAMERA_PRESET_1,  // After pressing 1
+    CAMERA_PRESET_2,  // After pressing 2
+    CAMERA_TURNTABLE, // Turntable orbit from the start position, after the given number of frames
+    CAMERA_ROTATED    // Prism rotation from the start position, after the given number of frames
+};
+
+extern TripleBuffer<FrameSnapshot> frameSnapshots;
+extern WakeEvent inputEvent; // Signalled by the main thread whenever a key changes state
+extern WakeEvent frameEvent; // Signalled whenever the render thread has something new to draw
+extern std::atomic<bool> QUIT_REQUESTED;
+extern std::atomic<long long> inputTimeShown; // The last FrameSnapshot::inputTime the render thread has drawn
+extern std::atomic<long long> nextFrameStart; // inputTimestamp() the render thread's next frame is expected at, or 0
+
+extern glm::vec3 c;
+extern bool PRISMS_SPIN_IN_PLACE; // Rotate mode spins every prism about its own x axis instead of turning the model
+
+// Steady clock time in nanoseconds, as key presses are stamped with
+long long inputTimestamp();
+
+void recordKeyEvent(int key, int action);
+bool simulateTick();
+void captureSnapshot(FrameSnapshot &snapshot);
+void scriptedSnapshot(CameraScript script, int frame, FrameSnapshot &snapshot);
+glm::vec3 turntablePosition(float frame);
+void simulationLoop();
+
+#endif
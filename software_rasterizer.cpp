@@ -0,0 +1,489 @@
+#include "software_rasterizer.h"
+#include <math.h>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Input triangles per setup/binning job
+const int RASTER_TRIANGLE_GRAIN = 2048;
+
+// Screen positions are snapped to 1/256 of a pixel so that shared edges evaluate to exactly opposite values
+const float RASTER_SUBPIXEL_SCALE = 256.0f;
+
+// Clipped vertices hold clip-space x, y, z, w followed by r, g, b
+const int CLIP_VERTEX_SIZE = 7;
+const int CLIP_PLANE_COUNT = 6;
+const int CLIP_MAX_VERTICES = 3 + CLIP_PLANE_COUNT;
+
+static inline uint32_t packColor(float r, float g, float b)
+{
+    uint32_t ri = (uint32_t)lrintf(fminf(fmaxf(r, 0.0f), 1.0f) * 255.0f);
+    uint32_t gi = (uint32_t)lrintf(fminf(fmaxf(g, 0.0f), 1.0f) * 255.0f);
+    uint32_t bi = (uint32_t)lrintf(fminf(fmaxf(b, 0.0f), 1.0f) * 255.0f);
+
+    return ri | (gi << 8) | (bi << 16) | 0xFF000000u;
+}
+
+// Signed distance of a clip-space vertex to plane i: near, far, then the four guard band planes
+static inline float clipDistance(const float *v, int plane, float guardBand)
+{
+    switch (plane)
+    {
+    case 0:
+        return v[2] + v[3];
+    case 1:
+        return v[3] - v[2];
+    case 2:
+        return v[0] + guardBand * v[3];
+    case 3:
+        return guardBand * v[3] - v[0];
+    case 4:
+        return v[1] + guardBand * v[3];
+    default:
+        return guardBand * v[3] - v[1];
+    }
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, JobSystem &jobs)
+    : width(width), height(height), jobs(jobs), binsUsed(0)
+{
+    stride = (width + 3) & ~3;
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    // Clip far enough outside the viewport that clipping is rare, but keep snapped coordinates small enough to be
+    // exact in double precision
+    guardBand = 8192.0f / (float)(width > height ? width : height);
+    if (guardBand < 1.0f)
+        guardBand = 1.0f;
+
+    color.resize(stride * height);
+    depth.resize(stride * height);
+}
+
+void SoftwareRasterizer::clear(glm::vec3 clearColor)
+{
+    uint32_t packed = packColor(clearColor.r, clearColor.g, clearColor.b);
+
+    jobs.parallelFor(0, height, 64, [&](int begin, int end) {
+        for (int i = begin * stride; i < end * stride; i++)
+        {
+            color[i] = packed;
+            depth[i] = 1.0f;
+        }
+    });
+}
+
+void SoftwareRasterizer::draw(const float *vertices, const uint32_t *indices, int indexCount, const glm::mat4 &mvp)
+{
+    int triangleCount = indexCount / 3;
+    int chunkCount = (triangleCount + RASTER_TRIANGLE_GRAIN - 1) / RASTER_TRIANGLE_GRAIN;
+    int tileCount = tilesX * tilesY;
+
+    if ((int)bins.size() < chunkCount)
+        bins.resize(chunkCount);
+    binsUsed = chunkCount;
+
+    // Vertex transform, clipping, triangle setup and binning, one job per chunk of input triangles
+    jobs.parallelFor(0, chunkCount, 1, [&](int begin, int end) {
+        for (int chunk = begin; chunk < end; chunk++)
+        {
+            Bin &bin = bins[chunk];
+            bin.triangles.clear();
+            bin.tiles.resize(tileCount);
+            for (int tile = 0; tile < tileCount; tile++)
+                bin.tiles[tile].clear();
+
+            int first = chunk * RASTER_TRIANGLE_GRAIN;
+            int last = first + RASTER_TRIANGLE_GRAIN < triangleCount ? first + RASTER_TRIANGLE_GRAIN : triangleCount;
+            setupChunk(vertices, indices, first, last, mvp, bin);
+        }
+    });
+
+    // Rasterisation, one job per tile; tiles never share pixels so no locking is needed
+    jobs.parallelFor(0, tileCount, 1, [&](int begin, int end) {
+        for (int tile = begin; tile < end; tile++)
+            rasterizeTile(tile);
+    });
+}
+
+void SoftwareRasterizer::readPixels(Image &image) const
+{
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(4 * width * height);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t pixel = color[y * stride + x];
+            unsigned char *target = &image.pixels[4 * (y * width + x)];
+            target[0] = pixel & 0xFF;
+            target[1] = (pixel >> 8) & 0xFF;
+            target[2] = (pixel >> 16) & 0xFF;
+            target[3] = pixel >> 24;
+        }
+}
+
+void SoftwareRasterizer::setupChunk(const float *vertices, const uint32_t *indices, int firstTriangle, int lastTriangle, const glm::mat4 &mvp, Bin &bin)
+{
+    float polygons[2][CLIP_MAX_VERTICES][CLIP_VERTEX_SIZE];
+    float screen[CLIP_MAX_VERTICES][CLIP_VERTEX_SIZE];
+
+    for (int triangle = firstTriangle; triangle < lastTriangle; triangle++)
+    {
+        // Vertex stage
+        const uint32_t *corners = &indices[3 * triangle];
+        unsigned int outsideAll = (1u << CLIP_PLANE_COUNT) - 1, outsideAny = 0;
+
+        for (int i = 0; i < 3; i++)
+        {
+            const float *source = &vertices[6 * corners[i]];
+            glm::vec4 clip = mvp * glm::vec4(source[0], source[1], source[2], 1.0f);
+            float *target = polygons[0][i];
+
+            target[0] = clip.x;
+            target[1] = clip.y;
+            target[2] = clip.z;
+            target[3] = clip.w;
+            target[4] = source[3];
+            target[5] = source[4];
+            target[6] = source[5];
+
+            unsigned int outside = 0;
+            for (int plane = 0; plane < CLIP_PLANE_COUNT; plane++)
+                if (clipDistance(target, plane, guardBand) < 0.0f)
+                    outside |= 1u << plane;
+            outsideAll &= outside;
+            outsideAny |= outside;
+        }
+
+        // Entirely outside one of the planes
+        if (outsideAll)
+            continue;
+
+        // Sutherland-Hodgman against every plane some vertex is outside of
+        int count = 3, current = 0;
+        for (int plane = 0; plane < CLIP_PLANE_COUNT && count > 0; plane++)
+        {
+            if (!(outsideAny & (1u << plane)))
+                continue;
+
+            float(*in)[CLIP_VERTEX_SIZE] = polygons[current];
+            float(*out)[CLIP_VERTEX_SIZE] = polygons[1 - current];
+            int outCount = 0;
+
+            for (int i = 0; i < count; i++)
+            {
+                const float *a = in[i];
+                const float *b = in[(i + 1) % count];
+                float da = clipDistance(a, plane, guardBand);
+                float db = clipDistance(b, plane, guardBand);
+
+                if (da >= 0.0f)
+                {
+                    for (int k = 0; k < CLIP_VERTEX_SIZE; k++)
+                        out[outCount][k] = a[k];
+                    outCount++;
+                }
+                if ((da >= 0.0f) != (db >= 0.0f))
+                {
+                    float t = da / (da - db);
+                    for (int k = 0; k < CLIP_VERTEX_SIZE; k++)
+                        out[outCount][k] = a[k] + t * (b[k] - a[k]);
+                    outCount++;
+                }
+            }
+
+            count = outCount;
+            current = 1 - current;
+        }
+
+        if (count < 3)
+            continue;
+
+        // Perspective divide and viewport transform; attributes are divided by w for perspective-correct interpolation
+        for (int i = 0; i < count; i++)
+        {
+            const float *v = polygons[current][i];
+            float invW = 1.0f / v[3];
+
+            screen[i][0] = roundf((v[0] * invW * 0.5f + 0.5f) * width * RASTER_SUBPIXEL_SCALE) / RASTER_SUBPIXEL_SCALE;
+            screen[i][1] = roundf((v[1] * invW * 0.5f + 0.5f) * height * RASTER_SUBPIXEL_SCALE) / RASTER_SUBPIXEL_SCALE;
+            screen[i][2] = v[2] * invW * 0.5f + 0.5f;
+            screen[i][3] = invW;
+            screen[i][4] = v[4] * invW;
+            screen[i][5] = v[5] * invW;
+            screen[i][6] = v[6] * invW;
+        }
+
+        for (int i = 1; i + 1 < count; i++)
+            setupTriangle(screen[0], screen[i], screen[i + 1], bin);
+    }
+}
+
+void SoftwareRasterizer::setupTriangle(const float *v0, const float *v1, const float *v2, Bin &bin)
+{
+    double area = ((double)v1[0] - v0[0]) * ((double)v2[1] - v0[1]) - ((double)v2[0] - v0[0]) * ((double)v1[1] - v0[1]);
+    if (area == 0.0)
+        return;
+
+    // No face culling, so bring clockwise triangles into counter-clockwise order
+    if (area < 0.0)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    SetupTriangle triangle;
+    const float *v[3] = {v0, v1, v2};
+
+    float minX = fminf(v0[0], fminf(v1[0], v2[0])), maxX = fmaxf(v0[0], fmaxf(v1[0], v2[0]));
+    float minY = fminf(v0[1], fminf(v1[1], v2[1])), maxY = fmaxf(v0[1], fmaxf(v1[1], v2[1]));
+
+    // Pixels whose centres can lie inside the triangle
+    triangle.minX = (int)ceilf(minX - 0.5f);
+    triangle.maxX = (int)floorf(maxX - 0.5f);
+    triangle.minY = (int)ceilf(minY - 0.5f);
+    triangle.maxY = (int)floorf(maxY - 0.5f);
+    if (triangle.minX < 0)
+        triangle.minX = 0;
+    if (triangle.minY < 0)
+        triangle.minY = 0;
+    if (triangle.maxX > width - 1)
+        triangle.maxX = width - 1;
+    if (triangle.maxY > height - 1)
+        triangle.maxY = height - 1;
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    // Edge i is opposite vertex i and is positive inside the triangle
+    for (int i = 0; i < 3; i++)
+    {
+        const float *a = v[(i + 1) % 3];
+        const float *b = v[(i + 2) % 3];
+
+        triangle.edgeA[i] = (double)a[1] - b[1];
+        triangle.edgeB[i] = (double)b[0] - a[0];
+        triangle.edgeC[i] = (double)a[0] * b[1] - (double)a[1] * b[0];
+        // Top-left rule: pixels exactly on a left edge or a top edge belong to this triangle
+        triangle.topLeft[i] = triangle.edgeA[i] > 0.0 || (triangle.edgeA[i] == 0.0 && triangle.edgeB[i] < 0.0);
+
+        if (triangle.edgeA[i] != 0.0)
+        {
+            triangle.spanSlope[i] = -triangle.edgeB[i] / triangle.edgeA[i];
+            triangle.spanOffset[i] = -triangle.edgeC[i] / triangle.edgeA[i] - 0.5;
+        }
+    }
+
+    // Attribute planes, taken relative to the centre of the first pixel in the bounds to keep the values small
+    triangle.originX = triangle.minX + 0.5f;
+    triangle.originY = triangle.minY + 0.5f;
+    for (int k = 0; k < 5; k++)
+    {
+        double dx = 0.0, dy = 0.0, c = 0.0;
+        for (int i = 0; i < 3; i++)
+        {
+            dx += triangle.edgeA[i] * v[i][2 + k];
+            dy += triangle.edgeB[i] * v[i][2 + k];
+            c += triangle.edgeC[i] * v[i][2 + k];
+        }
+
+        triangle.planes[k][0] = (float)(dx / area);
+        triangle.planes[k][1] = (float)(dy / area);
+        triangle.planes[k][2] = (float)((dx * triangle.originX + dy * triangle.originY + c) / area);
+    }
+
+    uint32_t index = (uint32_t)bin.triangles.size();
+    bin.triangles.push_back(triangle);
+
+    for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++)
+        for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++)
+        {
+            // Skip tiles that lie entirely outside one of the edges; long thin triangles (like the cap fans of a
+            // prism with many sides) cross far fewer tiles than their bounding boxes cover
+            bool outside = false;
+            for (int i = 0; i < 3 && !outside; i++)
+            {
+                double x = tx * TILE_SIZE + (triangle.edgeA[i] > 0.0 ? TILE_SIZE - 0.5 : 0.5);
+                double y = ty * TILE_SIZE + (triangle.edgeB[i] > 0.0 ? TILE_SIZE - 0.5 : 0.5);
+                outside = triangle.edgeA[i] * x + triangle.edgeB[i] * y + triangle.edgeC[i] < 0.0;
+            }
+
+            if (!outside)
+                bin.tiles[ty * tilesX + tx].push_back(index);
+        }
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile)
+{
+    int tileMinX = (tile % tilesX) * TILE_SIZE;
+    int tileMinY = (tile / tilesX) * TILE_SIZE;
+    int tileMaxX = tileMinX + TILE_SIZE < width ? tileMinX + TILE_SIZE - 1 : width - 1;
+    int tileMaxY = tileMinY + TILE_SIZE < height ? tileMinY + TILE_SIZE - 1 : height - 1;
+
+    // Chunks are visited in input order, so triangles are drawn in submission order like on the GPU
+    for (int chunk = 0; chunk < binsUsed; chunk++)
+    {
+        const Bin &bin = bins[chunk];
+        const std::vector<uint32_t> &indices = bin.tiles[tile];
+
+        for (size_t i = 0; i < indices.size(); i++)
+            rasterizeTriangle(bin.triangles[indices[i]], tileMinX, tileMinY, tileMaxX, tileMaxY);
+    }
+}
+
+// Narrow [startX, endX] down to the pixels of row py that can be inside the triangle. The bounds are solved from
+// the edge equations and padded by a pixel; the exact edge tests during rasterisation still decide coverage.
+static inline bool rowSpan(const SoftwareRasterizer::SetupTriangle &triangle, double py, int startX, int endX, int &rowStart, int &rowEnd)
+{
+    double low = startX, high = endX;
+
+    for (int i = 0; i < 3; i++)
+    {
+        // Where edge i crosses this row, as a pixel index
+        double crossing = triangle.spanSlope[i] * py + triangle.spanOffset[i];
+
+        if (triangle.edgeA[i] > 0.0)
+            low = fmax(low, crossing - 1.0);
+        else if (triangle.edgeA[i] < 0.0)
+            high = fmin(high, crossing + 1.0);
+        else if (triangle.edgeB[i] * py + triangle.edgeC[i] < 0.0)
+            return false;
+    }
+
+    if (low > high)
+        return false;
+
+    rowStart = (int)ceil(low);
+    rowEnd = (int)floor(high);
+    return rowStart <= rowEnd;
+}
+
+void SoftwareRasterizer::rasterizeTriangle(const SetupTriangle &triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+    // Blocks of 4 pixels start on multiples of 4, so they never straddle two tiles
+    int startX = (triangle.minX > tileMinX ? triangle.minX : tileMinX) & ~3;
+    int endX = triangle.maxX < tileMaxX ? triangle.maxX : tileMaxX;
+    int startY = triangle.minY > tileMinY ? triangle.minY : tileMinY;
+    int endY = triangle.maxY < tileMaxY ? triangle.maxY : tileMaxY;
+
+#ifdef __SSE2__
+    const __m128 laneIndex = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+    __m128 laneStep[3];
+
+    for (int i = 0; i < 3; i++)
+        laneStep[i] = _mm_mul_ps(_mm_set1_ps((float)triangle.edgeA[i]), laneIndex);
+
+    __m128 planeX[5], planeY[5], planeC[5];
+    for (int k = 0; k < 5; k++)
+    {
+        planeX[k] = _mm_set1_ps(triangle.planes[k][0]);
+        planeY[k] = _mm_set1_ps(triangle.planes[k][1]);
+        planeC[k] = _mm_set1_ps(triangle.planes[k][2]);
+    }
+
+    for (int y = startY; y <= endY; y++)
+    {
+        double py = y + 0.5;
+        __m128 dy = _mm_set1_ps((float)(y - triangle.minY));
+        int rowStart, rowEnd;
+
+        if (!rowSpan(triangle, py, startX, endX, rowStart, rowEnd))
+            continue;
+
+        for (int x = rowStart & ~3; x <= rowEnd; x += 4)
+        {
+            double px = x + 0.5;
+            __m128 inside = _mm_cmple_ps(_mm_add_ps(_mm_set1_ps((float)x), laneIndex), _mm_set1_ps((float)rowEnd));
+
+            // Edge functions; each block starts from an exact double evaluation so neighbours agree bit for bit
+            for (int i = 0; i < 3; i++)
+            {
+                float base = (float)(triangle.edgeA[i] * px + triangle.edgeB[i] * py + triangle.edgeC[i]);
+                __m128 edge = _mm_add_ps(_mm_set1_ps(base), laneStep[i]);
+                inside = _mm_and_ps(inside, triangle.topLeft[i] ? _mm_cmpge_ps(edge, zero) : _mm_cmpgt_ps(edge, zero));
+            }
+
+            if (!_mm_movemask_ps(inside))
+                continue;
+
+            __m128 dx = _mm_add_ps(_mm_set1_ps((float)(x - triangle.minX)), laneIndex);
+            __m128 z = _mm_add_ps(planeC[0], _mm_add_ps(_mm_mul_ps(planeX[0], dx), _mm_mul_ps(planeY[0], dy)));
+
+            // Depth test (GL_LESS)
+            float *depthRow = &depth[y * stride + x];
+            __m128 oldDepth = _mm_loadu_ps(depthRow);
+            __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, oldDepth));
+            if (!_mm_movemask_ps(pass))
+                continue;
+
+            _mm_storeu_ps(depthRow, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, oldDepth)));
+
+            // Perspective-correct colour
+            __m128 values[4];
+            for (int k = 1; k < 5; k++)
+                values[k - 1] = _mm_add_ps(planeC[k], _mm_add_ps(_mm_mul_ps(planeX[k], dx), _mm_mul_ps(planeY[k], dy)));
+
+            __m128 w = _mm_div_ps(one, values[0]);
+            __m128i channels[3];
+            for (int k = 0; k < 3; k++)
+            {
+                __m128 value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(values[k + 1], w), zero), one);
+                channels[k] = _mm_cvtps_epi32(_mm_mul_ps(value, scale));
+            }
+
+            __m128i packed = _mm_or_si128(_mm_or_si128(channels[0], _mm_slli_epi32(channels[1], 8)),
+                                          _mm_or_si128(_mm_slli_epi32(channels[2], 16), alpha));
+            __m128i passMask = _mm_castps_si128(pass);
+            __m128i *colorRow = (__m128i *)&color[y * stride + x];
+            __m128i oldColor = _mm_loadu_si128(colorRow);
+            _mm_storeu_si128(colorRow, _mm_or_si128(_mm_and_si128(passMask, packed), _mm_andnot_si128(passMask, oldColor)));
+        }
+    }
+#else
+    for (int y = startY; y <= endY; y++)
+    {
+        double py = y + 0.5;
+        float dy = (float)(y - triangle.minY);
+        int rowStart, rowEnd;
+
+        if (!rowSpan(triangle, py, startX, endX, rowStart, rowEnd))
+            continue;
+
+        for (int x = rowStart; x <= rowEnd; x++)
+        {
+            double px = x + 0.5;
+            bool inside = true;
+
+            for (int i = 0; i < 3 && inside; i++)
+            {
+                float edge = (float)(triangle.edgeA[i] * px + triangle.edgeB[i] * py + triangle.edgeC[i]);
+                inside = triangle.topLeft[i] ? edge >= 0.0f : edge > 0.0f;
+            }
+
+            if (!inside)
+                continue;
+
+            float dx = (float)(x - triangle.minX);
+            float values[5];
+            for (int k = 0; k < 5; k++)
+                values[k] = triangle.planes[k][2] + (triangle.planes[k][0] * dx + triangle.planes[k][1] * dy);
+
+            float &depthValue = depth[y * stride + x];
+            if (!(values[0] < depthValue))
+                continue;
+
+            float w = 1.0f / values[1];
+            depthValue = values[0];
+            color[y * stride + x] = packColor(values[2] * w, values[3] * w, values[4] * w);
+        }
+    }
+#endif
+}
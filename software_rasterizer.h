@@ -0,0 +1,61 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "image.h"
+#include "job_system.h"
+
+// Multithreaded tile-based CPU rasterizer
+// ---------------------------------------
+// Draws the same indexed interleaved position/RGB triangle lists as the GL path, with the same MVP, clip-space
+// clipping, top-left fill rule and GL_LESS depth test. Triangles are set up and binned into screen tiles in
+// parallel chunks, then every tile is rasterised by one job with SSE edge functions, 4 pixels at a time.
+class SoftwareRasterizer
+{
+public:
+    static const int TILE_SIZE = 64;
+
+    SoftwareRasterizer(int width, int height, JobSystem &jobs);
+
+    void clear(glm::vec3 color);
+    void draw(const float *vertices, const uint32_t *indices, int indexCount, const glm::mat4 &mvp);
+    void readPixels(Image &image) const;
+
+    // Screen-space triangle ready for rasterisation: edge and attribute plane equations plus its pixel bounds
+    struct SetupTriangle
+    {
+        int minX, minY, maxX, maxY;
+        double edgeA[3], edgeB[3], edgeC[3];
+        bool topLeft[3];
+        double spanSlope[3], spanOffset[3]; // Pixel x where each edge crosses a row, as a function of the row's y
+        float originX, originY;
+        float planes[5][3]; // z, 1/w, r/w, g/w, b/w as (d/dx, d/dy, value at origin)
+    };
+
+private:
+    // Triangles from one chunk of the input and, per tile, which of them touch it
+    struct Bin
+    {
+        std::vector<SetupTriangle> triangles;
+        std::vector<std::vector<uint32_t>> tiles;
+    };
+
+    void setupChunk(const float *vertices, const uint32_t *indices, int firstTriangle, int lastTriangle, const glm::mat4 &mvp, Bin &bin);
+    void setupTriangle(const float *v0, const float *v1, const float *v2, Bin &bin);
+    void rasterizeTile(int tile);
+    void rasterizeTriangle(const SetupTriangle &triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+
+    int width, height;
+    int stride; // Pixels per row, padded to a multiple of 4 for the SIMD loops
+    int tilesX, tilesY;
+    float guardBand;
+    JobSystem &jobs;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+    std::vector<Bin> bins;
+    int binsUsed;
+};
+
+#endif
@@ -0,0 +1,378 @@
+#include "stats_overlay.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include "threading.h"
+
+const GLuint OVERLAY_RECT_LOCATION = 0;
+const GLuint OVERLAY_GLYPH_LOCATION = 1;
+const GLuint OVERLAY_COLOR_LOCATION = 2;
+
+// Glyphs are 5x7 texels, each in a 6x8 cell of the atlas, 16 cells to a row, drawn at this many pixels per texel
+const int FONT_FIRST_CHAR = 32;
+const int FONT_GLYPH_COUNT = 65; // Space to underscore, then a solid block
+const int FONT_COLUMNS = 16;
+const int FONT_SCALE = 2;
+const uint32_t OVERLAY_SOLID_GLYPH = FONT_GLYPH_COUNT - 1;
+
+// Layout, in pixels
+const int OVERLAY_MARGIN = 8;
+const int OVERLAY_PADDING = 6;
+const int OVERLAY_LINE_HEIGHT = 9 * FONT_SCALE;
+const int OVERLAY_ADVANCE = 6 * FONT_SCALE;
+const int OVERLAY_GRAPH_HEIGHT = 48;
+const double OVERLAY_GRAPH_MS = 33.3; // Frame time at the top of the graph; bars of longer frames are cut off
+
+// Rows of every glyph from the top, one bit per texel with the leftmost in bit 4; lower case is drawn as upper case
+static const uint8_t FONT_GLYPHS[FONT_GLYPH_COUNT][7] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Space
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // !
+    {0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00}, // "
+    {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}, // #
+    {0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04}, // $
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // %
+    {0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D}, // &
+    {0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}, // '
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // (
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // )
+    {0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00}, // *
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // +
+    {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}, // ,
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // .
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // /
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // 2
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // 9
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // :
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08}, // ;
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // <
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // =
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // >
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // ?
+    {0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E}, // @
+    {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11}, // A
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // B
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // C
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // D
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // E
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // F
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // G
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // H
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // I
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // L
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // N
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // O
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // P
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // Q
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // R
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // S
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // W
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // X
+    {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, // Y
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // Z
+    {0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E}, // [
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // Backslash
+    {0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E}, // ]
+    {0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00}, // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}, // _
+    {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F}, // Solid
+};
+
+static const uint8_t TEXT_COLOR[4] = {255, 255, 255, 255};
+static const uint8_t DIM_TEXT_COLOR[4] = {170, 170, 170, 255};
+static const uint8_t BACKGROUND_COLOR[4] = {0, 0, 0, 160};
+static const uint8_t REFERENCE_COLOR[4] = {255, 255, 255, 90};
+static const uint8_t FAST_COLOR[4] = {90, 220, 90, 255};
+static const uint8_t SLOW_COLOR[4] = {240, 200, 60, 255};
+static const uint8_t STALL_COLOR[4] = {240, 70, 60, 255};
+
+// Corners of the quad come from the vertex index, as a triangle strip; the atlas is read texel by texel
+const char *overlayVertexShaderSource = "#version 330 core\n"
+                                        "layout (location = 0) in ivec4 aRect;\n"
+                                        "layout (location = 1) in uint aGlyph;\n"
+                                        "layout (location = 2) in vec4 aColor;\n"
+                                        "uniform vec2 viewport;\n"
+                                        "out vec2 texel;\n"
+                                        "flat out vec4 color;\n"
+                                        "void main()\n"
+                                        "{\n"
+                                        "   vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+                                        "   vec2 pixel = vec2(aRect.xy) + corner * vec2(aRect.zw);\n"
+                                        "   gl_Position = vec4(pixel.x * 2.0 / viewport.x - 1.0, 1.0 - pixel.y * 2.0 / viewport.y, 0.0, 1.0);\n"
+                                        "   texel = vec2(aGlyph % 16u, aGlyph / 16u) * vec2(6.0, 8.0) + corner * vec2(5.0, 7.0);\n"
+                                        "   color = aColor;\n"
+                                        "}\0";
+
+const char *overlayFragmentShaderSource = "#version 330 core\n"
+                                          "out vec4 FragColor;\n"
+                                          "in vec2 texel;\n"
+                                          "flat in vec4 color;\n"
+                                          "uniform sampler2D font;\n"
+                                          "void main()\n"
+                                          "{\n"
+                                          "   FragColor = vec4(color.rgb, color.a * texelFetch(font, ivec2(texel), 0).r);\n"
+                                          "}\n\0";
+
+// Counts too long for the panel in thousands or millions
+static void formatCount(unsigned long long count, char *buffer, size_t size)
+{
+    if (count >= 10000000ULL)
+        snprintf(buffer, size, "%.1fM", count / 1e6);
+    else if (count >= 10000ULL)
+        snprintf(buffer, size, "%.1fK", count / 1e3);
+    else
+        snprintf(buffer, size, "%llu", count);
+}
+
+StatsOverlay::StatsOverlay()
+{
+    program = buildShaderProgram(overlayVertexShaderSource, overlayFragmentShaderSource);
+    viewportLocation = glGetUniformLocation(program, "viewport");
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "font"), 0);
+    glUseProgram(0);
+
+    // Bake the font into a single-channel atlas, a byte per texel
+    const int atlasWidth = FONT_COLUMNS * 6;
+    const int atlasHeight = (FONT_GLYPH_COUNT + FONT_COLUMNS - 1) / FONT_COLUMNS * 8;
+    std::vector<uint8_t> atlas(atlasWidth * atlasHeight, 0);
+    for (int glyph = 0; glyph < FONT_GLYPH_COUNT; glyph++)
+    {
+        int left = glyph % FONT_COLUMNS * 6, top = glyph / FONT_COLUMNS * 8;
+        for (int row = 0; row < 7; row++)
+            for (int column = 0; column < 5; column++)
+                if (FONT_GLYPHS[glyph][row] & (0x10 >> column))
+                    atlas[(top + row) * atlasWidth + left + column] = 255;
+    }
+
+    glGenTextures(1, &font);
+    glBindTexture(GL_TEXTURE_2D, font);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Every attribute is per quad; the pointers are set each frame, as the quads move around the stream buffer
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    for (GLuint location = OVERLAY_RECT_LOCATION; location <= OVERLAY_COLOR_LOCATION; location++)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindVertexArray(0);
+
+    stream = new StreamBuffer(MAX_QUADS * sizeof(OverlayQuad));
+    quads = NULL;
+    quadCount = 0;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    viewportWidth = viewport[2];
+    viewportHeight = viewport[3];
+    renderWidth = renderHeight = 0;
+
+    haveLastFrame = false;
+    frameCount = nextFrame = 0;
+    cpuMs = overlayMs = 0.0;
+
+    timers = new GpuTimerRing(TIMER_FRAMES, 3);
+    gpuMs = overlayGpuMs = 0.0;
+}
+
+StatsOverlay::~StatsOverlay()
+{
+    delete stream;
+    delete timers;
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteTextures(1, &font);
+    glDeleteProgram(program);
+}
+
+void StatsOverlay::setViewport(int width, int height)
+{
+    viewportWidth = width;
+    viewportHeight = height;
+}
+
+void StatsOverlay::setRenderResolution(int width, int height)
+{
+    renderWidth = width;
+    renderHeight = height;
+}
+
+void StatsOverlay::beginFrame()
+{
+    // Show the latest frame whose timestamps have landed
+    GLuint64 stamps[3];
+    while (timers->read(stamps))
+    {
+        gpuMs = (stamps[1] - stamps[0]) / 1e6;
+        overlayGpuMs = (stamps[2] - stamps[1]) / 1e6;
+    }
+
+    frameStart = std::chrono::steady_clock::now();
+    if (haveLastFrame)
+    {
+        frameMs[nextFrame] = millisecondsBetween(lastFrameStart, frameStart);
+        nextFrame = (nextFrame + 1) % HISTORY;
+        frameCount = std::min(frameCount + 1, (int)HISTORY);
+    }
+    lastFrameStart = frameStart;
+    haveLastFrame = true;
+
+    timers->stamp(0);
+}
+
+void StatsOverlay::markIdle()
+{
+    haveLastFrame = false;
+}
+
+void StatsOverlay::text(int x, int y, const char *string, const uint8_t color[4])
+{
+    for (; *string && quadCount < MAX_QUADS; string++, x += OVERLAY_ADVANCE)
+    {
+        int c = *string >= 'a' && *string <= 'z' ? *string - 'a' + 'A' : *string;
+        if (c == ' ' || c < FONT_FIRST_CHAR || c - FONT_FIRST_CHAR >= (int)OVERLAY_SOLID_GLYPH)
+            continue;
+
+        OverlayQuad &quad = quads[quadCount++];
+        quad.x = (int16_t)x;
+        quad.y = (int16_t)y;
+        quad.width = 5 * FONT_SCALE;
+        quad.height = 7 * FONT_SCALE;
+        quad.glyph = (uint32_t)(c - FONT_FIRST_CHAR);
+        for (int k = 0; k < 4; k++)
+            quad.color[k] = color[k];
+    }
+}
+
+void StatsOverlay::rectangle(int x, int y, int width, int height, const uint8_t color[4])
+{
+    if (quadCount == MAX_QUADS)
+        return;
+
+    OverlayQuad &quad = quads[quadCount++];
+    quad.x = (int16_t)x;
+    quad.y = (int16_t)y;
+    quad.width = (int16_t)width;
+    quad.height = (int16_t)height;
+    quad.glyph = OVERLAY_SOLID_GLYPH;
+    for (int k = 0; k < 4; k++)
+        quad.color[k] = color[k];
+}
+
+void StatsOverlay::draw(const FrameDrawStats &draws)
+{
+    std::chrono::steady_clock::time_point overlayStart = std::chrono::steady_clock::now();
+    cpuMs = millisecondsBetween(frameStart, overlayStart);
+    timers->stamp(1);
+
+    // Frame rate from the mean frame time, and the 99th percentile, over the frames in the graph
+    double totalMs = 0.0;
+    double sorted[HISTORY];
+    for (int i = 0; i < frameCount; i++)
+    {
+        totalMs += frameMs[i];
+        sorted[i] = frameMs[i];
+    }
+
+    double fps = totalMs > 0.0 ? 1000.0 * frameCount / totalMs : 0.0;
+    double p99 = 0.0;
+    if (frameCount > 0)
+    {
+        int rank = (frameCount * 99 + 99) / 100 - 1;
+        std::nth_element(sorted, sorted + rank, sorted + frameCount);
+        p99 = sorted[rank];
+    }
+
+    char triangles[16], instances[16];
+    formatCount(draws.triangles, triangles, sizeof(triangles));
+    formatCount(draws.instances, instances, sizeof(instances));
+
+    char lines[6][48];
+    int lineCount = 0;
+    snprintf(lines[lineCount++], sizeof(lines[0]), "FPS %6.1f   P99 %6.2f MS", fps, p99);
+    snprintf(lines[lineCount++], sizeof(lines[0]), "CPU %6.2f MS GPU %6.2f MS", cpuMs, gpuMs);
+    if (renderWidth > 0)
+        snprintf(lines[lineCount++], sizeof(lines[0]), "RENDER %dX%d (%d%%)", renderWidth, renderHeight,
+                 (int)(100.0 * renderHeight / std::max(viewportHeight, 1) + 0.5));
+    snprintf(lines[lineCount++], sizeof(lines[0]), "TRIS %s  INSTANCES %s", triangles, instances);
+    snprintf(lines[lineCount++], sizeof(lines[0]), "DRAWS %u  GL CALLS %u", draws.draws, draws.glCalls);
+    snprintf(lines[lineCount++], sizeof(lines[0]), "HUD %.3f MS  GPU %.3f MS", overlayMs, overlayGpuMs);
+
+    int textWidth = 0;
+    for (int i = 0; i < lineCount; i++)
+        textWidth = std::max(textWidth, (int)strlen(lines[i]) * OVERLAY_ADVANCE);
+    int panelWidth = std::max(textWidth, (int)HISTORY) + 2 * OVERLAY_PADDING;
+    int panelHeight = lineCount * OVERLAY_LINE_HEIGHT + OVERLAY_GRAPH_HEIGHT + 3 * OVERLAY_PADDING;
+
+    // Lay the quads out straight into the stream buffer: the background first, as quads are blended in order
+    stream->beginFrame(MAX_QUADS * sizeof(OverlayQuad));
+    GLintptr quadsOffset = 0;
+    quads = (OverlayQuad *)stream->allocate(MAX_QUADS * sizeof(OverlayQuad), sizeof(OverlayQuad), quadsOffset);
+    quadCount = 0;
+
+    int left = OVERLAY_MARGIN + OVERLAY_PADDING, top = OVERLAY_MARGIN + OVERLAY_PADDING;
+    rectangle(OVERLAY_MARGIN, OVERLAY_MARGIN, panelWidth, panelHeight, BACKGROUND_COLOR);
+    for (int i = 0; i < lineCount; i++)
+        text(left, top + i * OVERLAY_LINE_HEIGHT, lines[i], i == lineCount - 1 ? DIM_TEXT_COLOR : TEXT_COLOR);
+
+    // Frame times, oldest on the left, against a line at 60 frames per second
+    int graphBottom = top + lineCount * OVERLAY_LINE_HEIGHT + OVERLAY_PADDING + OVERLAY_GRAPH_HEIGHT;
+    rectangle(left, graphBottom - (int)(OVERLAY_GRAPH_HEIGHT * 16.7 / OVERLAY_GRAPH_MS), HISTORY, 1, REFERENCE_COLOR);
+    for (int i = 0; i < frameCount; i++)
+    {
+        double ms = frameMs[(nextFrame - frameCount + i + HISTORY) % HISTORY];
+        int height = std::max(1, (int)(OVERLAY_GRAPH_HEIGHT * std::min(ms, OVERLAY_GRAPH_MS) / OVERLAY_GRAPH_MS));
+        const uint8_t *color = ms <= 16.7 ? FAST_COLOR : ms <= 33.3 ? SLOW_COLOR : STALL_COLOR;
+        rectangle(left + HISTORY - frameCount + i, graphBottom - height, 1, height, color);
+    }
+    stream->flush();
+
+    // One draw for all of it, blended over the frame without touching depth
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(program);
+    glUniform2f(viewportLocation, (float)viewportWidth, (float)viewportHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, font);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer());
+    glVertexAttribIPointer(OVERLAY_RECT_LOCATION, 4, GL_SHORT, sizeof(OverlayQuad), (void *)quadsOffset);
+    glVertexAttribIPointer(OVERLAY_GLYPH_LOCATION, 1, GL_UNSIGNED_INT, sizeof(OverlayQuad), (void *)(quadsOffset + 8));
+    glVertexAttribPointer(OVERLAY_COLOR_LOCATION, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OverlayQuad), (void *)(quadsOffset + 12));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, quadCount);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    stream->endFrame();
+    quads = NULL;
+
+    timers->stamp(2);
+    timers->endFrame();
+
+    // Shown from the next frame on, as this one is already laid out
+    overlayMs = millisecondsBetween(overlayStart, std::chrono::steady_clock::now());
+}
@@ -0,0 +1,79 @@
+#ifndef STATS_OVERLAY_H
+#define STATS_OVERLAY_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <stdint.h>
+#include "gpu_timers.h"
+#include "renderer.h"
+#include "stream_buffer.h"
+
+// One glyph or solid rectangle of the overlay, in pixels from the top left of the viewport
+struct OverlayQuad
+{
+    int16_t x, y, width, height;
+    uint32_t glyph; // Index into the font atlas; OVERLAY_SOLID_GLYPH fills the whole rectangle
+    uint8_t color[4];
+};
+
+// Live frame statistics
+// ---------------------
+// Frame rate, the 99th percentile frame time, CPU and GPU time per frame, what the prisms' draws drew and how many
+// GL calls they took, over a rolling graph of recent frame times. Text comes from a 5x7 bitmap font baked into a
+// small texture once; every glyph, bar and the background is an instance of one quad, written straight into a
+// stream buffer, so the whole overlay is a single instanced draw after the prisms. GPU time is measured with
+// timestamp queries that are read back a few frames late, and only once they are available, so the overlay never
+// waits on the GPU. Must be created and used on the thread that owns the context.
+class StatsOverlay
+{
+public:
+    static const int HISTORY = 240;     // Frames in the graph and the percentile
+    static const int TIMER_FRAMES = 4;  // Frames of timestamp queries in flight
+    static const int MAX_QUADS = 1024;
+
+    StatsOverlay();
+    ~StatsOverlay();
+
+    void setViewport(int width, int height);
+
+    // The scene is drawn at a different resolution than the window's, to show alongside the timings
+    void setRenderResolution(int width, int height);
+
+    // Before anything of the frame is drawn
+    void beginFrame();
+
+    // The renderer sat idle since the last frame, so the time until the next one is not a frame time
+    void markIdle();
+
+    // After the prisms are drawn: ends the frame's CPU time, then lays the overlay out from the latest numbers and
+    // draws it over the frame
+    void draw(const FrameDrawStats &draws);
+
+private:
+    void text(int x, int y, const char *string, const uint8_t color[4]);
+    void rectangle(int x, int y, int width, int height, const uint8_t color[4]);
+
+    unsigned int program;
+    GLint viewportLocation;
+    GLuint font, vertexArray;
+    StreamBuffer *stream;
+    int viewportWidth, viewportHeight;
+    int renderWidth, renderHeight; // 0 when the scene is drawn at the window's resolution
+
+    // The frame being laid out, in the stream buffer
+    OverlayQuad *quads;
+    int quadCount;
+
+    std::chrono::steady_clock::time_point frameStart, lastFrameStart;
+    bool haveLastFrame;
+    double frameMs[HISTORY];
+    int frameCount; // Frames recorded in frameMs, up to HISTORY
+    int nextFrame;
+    double cpuMs, overlayMs;
+
+    // Three timestamps per frame: its start, the start of the overlay and the end of the overlay
+    GpuTimerRing *timers;
+    double gpuMs, overlayGpuMs;
+};
+
+#endif
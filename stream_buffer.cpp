@@ -0,0 +1,130 @@
+#include "stream_buffer.h"
+#include <chrono>
+
+// Segment sizes are kept a multiple of this so every segment starts on a valid uniform buffer offset
+const size_t STREAM_SEGMENT_ALIGNMENT = 256;
+
+StreamBuffer::StreamBuffer(size_t segmentSize) : bufferObject(0), segmentSize(0), used(0), segment(SEGMENT_COUNT - 1), mapped(NULL)
+{
+    for (int i = 0; i < SEGMENT_COUNT; i++)
+        fences[i] = NULL;
+
+    counters.frames = 0;
+    counters.bytesWritten = 0;
+    counters.fenceWaits = 0;
+    counters.fenceWaitMs = 0.0;
+    counters.glCalls = 0;
+
+    glGenBuffers(1, &bufferObject);
+    createStorage(segmentSize);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (int i = 0; i < SEGMENT_COUNT; i++)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+
+    glDeleteBuffers(1, &bufferObject);
+}
+
+void StreamBuffer::createStorage(size_t size)
+{
+    segmentSize = (size + STREAM_SEGMENT_ALIGNMENT - 1) / STREAM_SEGMENT_ALIGNMENT * STREAM_SEGMENT_ALIGNMENT;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+    glBufferData(GL_COPY_WRITE_BUFFER, SEGMENT_COUNT * segmentSize, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    counters.glCalls += 3;
+}
+
+void StreamBuffer::waitForSegment(int index)
+{
+    if (!fences[index])
+        return;
+
+    // Only count it as a wait if the GPU really is still reading this segment
+    GLenum result = glClientWaitSync(fences[index], 0, 0);
+    counters.glCalls++;
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            counters.glCalls++;
+        }
+
+        counters.fenceWaits++;
+        counters.fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    glDeleteSync(fences[index]);
+    counters.glCalls++;
+    fences[index] = NULL;
+}
+
+void StreamBuffer::beginFrame(size_t bytesNeeded)
+{
+    if (bytesNeeded > segmentSize)
+    {
+        // Every segment may still be in flight, so let all of them drain before the storage is replaced
+        for (int i = 0; i < SEGMENT_COUNT; i++)
+            waitForSegment(i);
+
+        size_t size = segmentSize;
+        while (size < bytesNeeded)
+            size *= 2;
+        createStorage(size);
+    }
+
+    segment = (segment + 1) % SEGMENT_COUNT;
+    waitForSegment(segment);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+    mapped = (unsigned char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, segment * segmentSize, segmentSize,
+                                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                                   GL_MAP_FLUSH_EXPLICIT_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    counters.glCalls += 3;
+    used = 0;
+}
+
+void *StreamBuffer::allocate(size_t size, size_t alignment, GLintptr &offset)
+{
+    size_t start = (used + alignment - 1) / alignment * alignment;
+    if (!mapped || start + size > segmentSize)
+        return NULL;
+
+    used = start + size;
+    offset = segment * segmentSize + start;
+    return mapped + start;
+}
+
+void StreamBuffer::flush()
+{
+    if (!mapped)
+        return;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+    if (used > 0)
+    {
+        glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, used);
+        counters.glCalls++;
+    }
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    counters.glCalls += 3;
+
+    mapped = NULL;
+    counters.bytesWritten += used;
+}
+
+void StreamBuffer::endFrame()
+{
+    flush();
+
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    counters.glCalls++;
+    counters.frames++;
+}
@@ -0,0 +1,65 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <stddef.h>
+
+struct StreamBufferStats
+{
+    unsigned long long frames;
+    unsigned long long bytesWritten;
+    unsigned long long fenceWaits; // Frames that found their segment still in use by the GPU
+    double fenceWaitMs;            // Total time spent blocked on those fences
+    unsigned long long glCalls;    // Made by the stream buffer, for mapping, flushing and fencing
+};
+
+// Streaming buffer for per-frame dynamic data
+// -------------------------------------------
+// One buffer object split into three segments that are used in turn, one per frame. A segment is written through
+// an unsynchronized, invalidating glMapBufferRange, so the driver never has to stall or shadow-copy it; instead
+// every segment is guarded by a fence placed after the draws that read it, and it is only reused once that fence
+// has signalled. The same buffer can be bound as uniform block storage or as a vertex/instance buffer.
+class StreamBuffer
+{
+public:
+    static const int SEGMENT_COUNT = 3;
+
+    explicit StreamBuffer(size_t segmentSize);
+    ~StreamBuffer();
+
+    // Move on to the next segment and map it; grows the buffer first if a frame needs more than a segment holds
+    void beginFrame(size_t bytesNeeded);
+
+    // Reserve size bytes in the current segment; offset receives the position in the whole buffer for binding
+    void *allocate(size_t size, size_t alignment, GLintptr &offset);
+
+    // Unmap the segment so it can be drawn from; must be called before the draws that read it
+    void flush();
+
+    // Fence the segment after the last draw that reads from it
+    void endFrame();
+
+    GLuint buffer() const
+    {
+        return bufferObject;
+    }
+
+    const StreamBufferStats &stats() const
+    {
+        return counters;
+    }
+
+private:
+    void createStorage(size_t size);
+    void waitForSegment(int index);
+
+    GLuint bufferObject;
+    size_t segmentSize;
+    size_t used;
+    int segment;
+    unsigned char *mapped;
+    GLsync fences[SEGMENT_COUNT];
+    StreamBufferStats counters;
+};
+
+#endif
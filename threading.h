@@ -0,0 +1,106 @@
+#ifndef THREADING_H
+#define THREADING_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Lock-free single-producer/single-consumer triple buffer
+// --------------------------------------------------------
+// The producer always owns one slot to write into and the consumer always owns one slot to read from; the third
+// slot is swapped atomically between them. Neither side ever waits for the other, and the consumer only ever sees
+// complete, published values.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Slot the producer may fill in; it is never touched by the consumer until publish() is called
+    T &writeBuffer()
+    {
+        return slots[writeIndex].value;
+    }
+
+    // Hand the write slot over to the consumer and take back whichever slot was in the middle
+    void publish()
+    {
+        unsigned int previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // Swap in the most recently published value, if there is one the consumer has not seen yet
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH_BIT))
+            return false;
+
+        unsigned int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    // Value the consumer currently owns
+    const T &readBuffer() const
+    {
+        return slots[readIndex].value;
+    }
+
+private:
+    static const unsigned int INDEX_MASK = 3;
+    static const unsigned int FRESH_BIT = 4;
+
+    // Keep each slot on its own cache line so the two threads never share one
+    struct alignas(64) Slot
+    {
+        T value;
+    };
+
+    Slot slots[3];
+    std::atomic<unsigned int> middle{1};
+    unsigned int writeIndex = 0;
+    unsigned int readIndex = 2;
+};
+
+// Auto-resetting event used to park a thread until there is work for it
+// ---------------------------------------------------------------------
+class WakeEvent
+{
+public:
+    void notify()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            signalled = true;
+        }
+        condition.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return signalled; });
+        signalled = false;
+    }
+
+    // As wait(), but gives up at deadline; returns whether the event was signalled
+    bool waitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool woken = condition.wait_until(lock, deadline, [this] { return signalled; });
+        signalled = false;
+        return woken;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool signalled = false;
+};
+
+// Time from start to end in milliseconds, for the stats of threads that pace or wait
+inline double millisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+#endif
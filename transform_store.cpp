@@ -0,0 +1,135 @@
+#include "transform_store.h"
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void TransformStore::build(const Scene &scene, const SceneGraph &graph)
+{
+    size_t count = scene.prisms.size();
+    for (int k = 0; k < 3; k++)
+    {
+        centre[k].resize(count);
+        axis[k].assign(count, k == 0 ? 1.0f : 0.0f);
+    }
+    for (int k = 0; k < 9; k++)
+        basis[k].resize(count);
+    angle.assign(count, 0.0f);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::mat4 transform = scenePrismTransform(scene.prisms[graph.prismOfNode((uint32_t)i)]);
+        for (int row = 0; row < 3; row++)
+        {
+            centre[row][i] = transform[3][row];
+            for (int column = 0; column < 3; column++)
+                basis[3 * row + column][i] = transform[column][row];
+        }
+    }
+}
+
+// basis * rotation(axis, angle + spin), with the rotation in Rodrigues' form
+void TransformStore::writeLocal(float spin, size_t i, AffineTransform &local) const
+{
+    float theta = angle[i] + spin;
+    float c = cosf(theta), s = sinf(theta), t = 1.0f - c;
+    float x = axis[0][i], y = axis[1][i], z = axis[2][i];
+    float rotation[9] = {t * x * x + c,     t * x * y - s * z, t * x * z + s * y,
+                         t * x * y + s * z, t * y * y + c,     t * y * z - s * x,
+                         t * x * z - s * y, t * y * z + s * x, t * z * z + c};
+
+    for (int row = 0; row < 3; row++)
+    {
+        float m[3];
+        for (int column = 0; column < 3; column++)
+            m[column] = basis[3 * row][i] * rotation[column] + basis[3 * row + 1][i] * rotation[3 + column] +
+                        basis[3 * row + 2][i] * rotation[6 + column];
+        local.rows[row] = glm::vec4(m[0], m[1], m[2], centre[row][i]);
+    }
+}
+
+#ifdef __SSE2__
+// Sine and cosine of four angles: reduced to [-pi/4, pi/4] around the nearest multiple of pi/2 (in three parts so
+// the reduction stays exact), then minimax polynomials, swapped and negated by quadrant
+static inline void sinCos4(__m128 x, __m128 &sine, __m128 &cosine)
+{
+    const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));
+    __m128 j = _mm_cvtepi32_ps(quadrant);
+    __m128 y = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(1.5703125f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(j, _mm_set1_ps(4.837512969970703125e-4f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(j, _mm_set1_ps(7.54978995489188216e-8f)));
+    __m128 y2 = _mm_mul_ps(y, y);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), y2), _mm_set1_ps(8.3321608736e-3f));
+    s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(-1.6666654611e-1f));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, y2), y), y);
+
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), y2), _mm_set1_ps(-1.388731625493765e-3f));
+    c = _mm_add_ps(_mm_mul_ps(c, y2), _mm_set1_ps(4.166664568298827e-2f));
+    c = _mm_mul_ps(_mm_mul_ps(c, y2), y2);
+    c = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), y2)), c);
+
+    // Odd quadrants swap sine and cosine; sine is negated in quadrants 2 and 3, cosine in 1 and 2
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+    sine = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    cosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    sine = _mm_xor_ps(sine, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30)));
+    cosine = _mm_xor_ps(cosine, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30)));
+}
+#endif
+
+void TransformStore::writeLocals(float spin, size_t begin, size_t end, AffineTransform *locals) const
+{
+    size_t i = begin;
+
+#ifdef __SSE2__
+    // Stores through __m128 may alias anything, so keep the arrays in locals rather than reloading them every store
+    const float *angles = angle.data();
+    const float *axes[3] = {axis[0].data(), axis[1].data(), axis[2].data()};
+    const float *centres[3] = {centre[0].data(), centre[1].data(), centre[2].data()};
+    const float *bases[9];
+    for (int k = 0; k < 9; k++)
+        bases[k] = basis[k].data();
+
+    const __m128 spin4 = _mm_set1_ps(spin);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 s, c;
+        sinCos4(_mm_add_ps(_mm_loadu_ps(angles + i), spin4), s, c);
+        __m128 t = _mm_sub_ps(one, c);
+
+        __m128 x = _mm_loadu_ps(axes[0] + i), y = _mm_loadu_ps(axes[1] + i), z = _mm_loadu_ps(axes[2] + i);
+        __m128 tx = _mm_mul_ps(t, x), ty = _mm_mul_ps(t, y), tz = _mm_mul_ps(t, z);
+        __m128 sx = _mm_mul_ps(s, x), sy = _mm_mul_ps(s, y), sz = _mm_mul_ps(s, z);
+        __m128 txy = _mm_mul_ps(tx, y), txz = _mm_mul_ps(tx, z), tyz = _mm_mul_ps(ty, z);
+
+        __m128 rotation[9] = {_mm_add_ps(_mm_mul_ps(tx, x), c), _mm_sub_ps(txy, sz), _mm_add_ps(txz, sy),
+                              _mm_add_ps(txy, sz), _mm_add_ps(_mm_mul_ps(ty, y), c), _mm_sub_ps(tyz, sx),
+                              _mm_sub_ps(txz, sy), _mm_add_ps(tyz, sx), _mm_add_ps(_mm_mul_ps(tz, z), c)};
+
+        // Row r of the four affines, one lane per prism, transposed into one vector per prism
+        for (int row = 0; row < 3; row++)
+        {
+            __m128 b0 = _mm_loadu_ps(bases[3 * row] + i), b1 = _mm_loadu_ps(bases[3 * row + 1] + i),
+                   b2 = _mm_loadu_ps(bases[3 * row + 2] + i);
+            __m128 m[4];
+            for (int column = 0; column < 3; column++)
+                m[column] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, rotation[column]), _mm_mul_ps(b1, rotation[3 + column])),
+                                       _mm_mul_ps(b2, rotation[6 + column]));
+            m[3] = _mm_loadu_ps(centres[row] + i);
+
+            _MM_TRANSPOSE4_PS(m[0], m[1], m[2], m[3]);
+            for (int lane = 0; lane < 4; lane++)
+                _mm_storeu_ps(&locals[i + lane].rows[row].x, m[lane]);
+        }
+    }
+#endif
+
+    for (; i < end; i++)
+        writeLocal(spin, i, locals[i]);
+}
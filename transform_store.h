@@ -0,0 +1,39 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "scene_graph.h"
+
+// Scene prism poses, structure of arrays
+// --------------------------------------
+// Every prism's pose in its parent's space is kept as its centre, its rest orientation and scale (a 3x3 basis), the
+// axis it spins about in its own space and its angle about that axis, each in an array of its own, in scene graph
+// node order. writeLocals() turns a range of them into local transforms, rotated by a common spin on top of their
+// own angle, four at a time with SSE2: the rotations are built with a vectorized sine and cosine, multiplied into
+// the bases and transposed into rows.
+class TransformStore
+{
+public:
+    // Prisms spin about their own x axis, as the single prism does in rotate mode
+    void build(const Scene &scene, const SceneGraph &graph);
+
+    size_t size() const
+    {
+        return angle.size();
+    }
+
+    // Local transforms of nodes [begin, end) spun by spin radians, node i to locals[i]
+    void writeLocals(float spin, size_t begin, size_t end, AffineTransform *locals) const;
+
+private:
+    void writeLocal(float spin, size_t i, AffineTransform &local) const;
+
+    std::vector<float> centre[3];
+    std::vector<float> basis[9]; // Row-major: basis[3 * row + column]
+    std::vector<float> axis[3];
+    std::vector<float> angle;
+};
+
+#endif